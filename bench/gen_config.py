@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Generate a benchmark Kamailio config from kamailio_web3_sample.cfg.
+
+The routing logic is kept as is; only what a local, unprivileged run
+needs is changed: listen address, module path, runtime files, logging,
+the RPC URL and extra web3_auth parameters. With --async-workers the
+checks run in Kamailio's async workers instead (see make_async()).
+"""
+
+import argparse
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SAMPLE = os.path.join(HERE, "..", "kamailio_web3_sample.cfg")
+
+
+CHECK_RE = re.compile(r'^(\s*)if\s*\(\s*!\s*web3_auth_check\(\)\s*\)\s*\{\s*$')
+ROUTE_RE = re.compile(r'^route\[(\w+)\]\s*\{')
+CONTINUE_ROUTE = "WEB3_AUTH_CONTINUE"
+
+
+def block_end(lines, start):
+    """Index of the line closing the block opened on lines[start]."""
+    depth = 0
+    for i in range(start, len(lines)):
+        depth += lines[i].count("{") - lines[i].count("}")
+        if depth == 0:
+            return i
+    raise ValueError("unbalanced block at line %d" % (start + 1))
+
+
+def make_async(lines):
+    """Turn each if(!web3_auth_check()) { ... } into web3_auth_check_async().
+
+    The transaction resumes in a route per calling route: the failure
+    block, reading $web3auth(result) instead of $rc, then the rest of the
+    calling route. A calling route that returns to request_route goes on
+    with what request_route does after it, moved to CONTINUE_ROUTE.
+    """
+    lines = list(lines)
+    resume = []
+    i = 0
+    while i < len(lines):
+        m = ROUTE_RE.match(lines[i])
+        if not m:
+            i += 1
+            continue
+        name, end = m.group(1), block_end(lines, i)
+        check = next((j for j in range(i, end) if CHECK_RE.match(lines[j])), None)
+        if check is None:
+            i = end + 1
+            continue
+        indent = CHECK_RE.match(lines[check]).group(1)
+        fail_end = block_end(lines, check)
+        rest = lines[fail_end + 1:end]
+        done = "WEB3_AUTH_DONE_" + name
+        resume += ["", "# %s resumed after web3_auth_check_async()" % name,
+                   "route[%s] {" % done,
+                   "%sif($web3auth(result) != 1) {" % indent]
+        resume += [l.replace("$rc", "$web3auth(result)") for l in lines[check + 1:fail_end]]
+        resume += ["%s}" % indent] + rest + ["}"]
+        lines[check] = '%sif(!web3_auth_check_async("%s")) {' % (indent, done)
+        if [l.strip() for l in rest if l.strip()][-1:] == ["return;"]:
+            k = len(resume) - 2
+            while resume[k].strip() != "return;":
+                k -= 1
+            resume[k] = resume[k].replace("return;", "route(%s);" % CONTINUE_ROUTE)
+            lines, tail = split_request_route(lines, name)
+            resume += ["", "route[%s] {" % CONTINUE_ROUTE] + tail + ["}"]
+        # line numbers may have moved; converted checks no longer match
+        i = 0
+    if not resume:
+        raise ValueError("no if(!web3_auth_check()) { ... } to make async")
+    return lines + resume
+
+
+def split_request_route(lines, name):
+    """Move what request_route does after route(name) to CONTINUE_ROUTE."""
+    start = next((i for i, l in enumerate(lines) if re.match(r'^request_route\s*\{', l)), None)
+    if start is None:
+        raise ValueError("no request_route")
+    end = block_end(lines, start)
+    call = next((i for i in range(start, end)
+                 if re.match(r'^\s*route\(%s\);\s*$' % name, lines[i])), None)
+    if call is None:
+        raise ValueError("route[%s] returns but is not called from request_route" % name)
+    indent = re.match(r'^(\s*)', lines[call]).group(1)
+    tail = lines[call + 1:end]
+    return lines[:call + 1] + ["%sroute(%s);" % (indent, CONTINUE_ROUTE)] + lines[end:], tail
+
+
+def generate(sample, listen, rpc_url, mpath, runtime_dir, children=8,
+             modparams=None, debug=1, async_workers=0):
+    with open(sample) as f:
+        lines = f.read().splitlines()
+    if async_workers:
+        lines = make_async(lines)
+
+    out = []
+    for line in lines:
+        # runs as the invoking user, on the benchmark address only
+        if re.match(r'^\s*(user|group)\s*=', line):
+            continue
+        if re.match(r'^\s*listen\s*=', line):
+            continue
+        m = re.match(r'^(\s*modparam\("web3_auth",\s*"rpc_url",\s*)"[^"]*"\)', line)
+        if m:
+            line = '%s"%s")' % (m.group(1), rpc_url)
+        if re.match(r'^\s*loadmodule\s+"web3_auth\.so"', line):
+            # auth_challenge() and has_credentials() come from auth
+            if not any(re.match(r'^\s*loadmodule\s+"auth\.so"', l) for l in lines):
+                out.append('loadmodule "auth.so"')
+        out.append(line)
+        if re.match(r'^\s*modparam\("web3_auth",\s*"contract_address"', line):
+            for name, value in (modparams or []):
+                if re.fullmatch(r'-?\d+', value):
+                    out.append('modparam("web3_auth", "%s", %s)' % (name, value))
+                else:
+                    out.append('modparam("web3_auth", "%s", "%s")' % (name, value))
+            out.append('modparam("ctl", "binrpc", "unix:%s/kamailio_ctl")' % runtime_dir)
+            out.append('modparam("jsonrpcs", "fifo_name", "%s/kamailio_rpc.fifo")' % runtime_dir)
+
+    text = "\n".join(out) + "\n"
+
+    header = [
+        "#!define MULTIDOMAIN 0" if "MULTIDOMAIN" in text and "#!define MULTIDOMAIN" not in text
+        else None,
+        "",
+        "####### Benchmark settings (generated by bench/gen_config.py) #######",
+        "debug=%d" % debug,
+        "log_stderror=yes",
+        "children=%d" % children,
+        "async_workers=%d" % async_workers if async_workers else None,
+        'mpath="%s"' % mpath,
+        'runtime_dir="%s"' % runtime_dir,
+        "listen=udp:%s" % listen,
+        "listen=tcp:%s" % listen,
+    ]
+    first, rest = text.split("\n", 1)
+    return first + "\n" + "\n".join(h for h in header if h is not None) + "\n" + rest
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("-o", "--output", default="-")
+    p.add_argument("--sample", default=SAMPLE)
+    p.add_argument("--listen", default="127.0.0.1:5060")
+    p.add_argument("--rpc-url", default="http://127.0.0.1:18545/")
+    p.add_argument("--mpath", required=True,
+                   help="module directories, ':' separated, including the one of web3_auth.so")
+    p.add_argument("--runtime-dir", default="/tmp/web3_auth_bench")
+    p.add_argument("--children", type=int, default=8)
+    p.add_argument("--debug", type=int, default=1)
+    p.add_argument("--modparam", action="append", default=[], metavar="NAME=VALUE",
+                   help="extra web3_auth parameter (repeatable)")
+    p.add_argument("--async-workers", type=int, default=0,
+                   help="check with web3_auth_check_async() in this many async workers")
+    a = p.parse_args()
+
+    modparams = [tuple(mp.split("=", 1)) for mp in a.modparam]
+    cfg = generate(a.sample, a.listen, a.rpc_url, a.mpath, a.runtime_dir,
+                   a.children, modparams, a.debug, a.async_workers)
+    if a.output == "-":
+        sys.stdout.write(cfg)
+    else:
+        with open(a.output, "w") as f:
+            f.write(cfg)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Mock Ethereum JSON-RPC node for benchmarking the web3_auth module.
+
+Answers eth_call for the contract methods the module uses by default:
+getDigestHash, getHA1, getHA1SHA256, getHA1SHA512_256 and their ...ById
+variants. Every user of the table has the same password. Unknown users
+get the "User not found" error the module maps to -3.
+"""
+
+import argparse
+import hashlib
+import json
+import random
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Keccak-256 as used by Ethereum (original padding, not SHA3-256)
+_RC = [
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+]
+_ROT = [
+    [0, 36, 3, 41, 18], [1, 44, 10, 45, 2], [62, 6, 43, 15, 61],
+    [28, 55, 25, 21, 56], [27, 20, 39, 8, 14],
+]
+_MASK = (1 << 64) - 1
+
+
+def _rol(v, n):
+    return ((v << n) | (v >> (64 - n))) & _MASK if n else v
+
+
+def _keccak_f(a):
+    for rc in _RC:
+        c = [a[x][0] ^ a[x][1] ^ a[x][2] ^ a[x][3] ^ a[x][4] for x in range(5)]
+        d = [c[(x - 1) % 5] ^ _rol(c[(x + 1) % 5], 1) for x in range(5)]
+        a = [[a[x][y] ^ d[x] for y in range(5)] for x in range(5)]
+        b = [[0] * 5 for _ in range(5)]
+        for x in range(5):
+            for y in range(5):
+                b[y][(2 * x + 3 * y) % 5] = _rol(a[x][y], _ROT[x][y])
+        a = [[b[x][y] ^ (~b[(x + 1) % 5][y] & b[(x + 2) % 5][y]) for y in range(5)]
+             for x in range(5)]
+        a[0][0] ^= rc
+    return a
+
+
+def keccak256(data):
+    rate = 136
+    msg = bytearray(data) + b"\x01" + b"\x00" * ((-len(data) - 1) % rate)
+    msg[-1] |= 0x80
+    a = [[0] * 5 for _ in range(5)]
+    for off in range(0, len(msg), rate):
+        for i in range(rate // 8):
+            a[i % 5][i // 5] ^= int.from_bytes(msg[off + 8 * i:off + 8 * i + 8], "little")
+        a = _keccak_f(a)
+    return b"".join(a[i % 5][i // 5].to_bytes(8, "little") for i in range(4))
+
+
+def selector(signature):
+    return keccak256(signature.encode()).hex()[:8]
+
+
+def _h(alg, text):
+    if alg == "sha512_256":
+        return hashlib.new("sha512_256", text.encode()).hexdigest()
+    return hashlib.new(alg, text.encode()).hexdigest()
+
+
+class Contract:
+    def __init__(self, users, password, realms):
+        self.users = set(users)
+        self.password = password
+        # keccak256 ids of the known names, for the ...ById methods
+        self.ids = {}
+        for name in list(users) + list(realms):
+            self.ids[keccak256(name.encode()).hex()] = name
+        self.methods = {}
+        for sig, fn in [
+            ("getDigestHash(string,string,string,string,string)", self.digest),
+            ("getDigestHashById(bytes32,bytes32,string,string,string)", self.digest),
+        ]:
+            self.methods[selector(sig)] = fn
+        for alg, name in [("md5", "getHA1"), ("sha256", "getHA1SHA256"),
+                          ("sha512_256", "getHA1SHA512_256")]:
+            for suffix, types in [("", "string,string"), ("ById", "bytes32,bytes32")]:
+                sig = "%s%s(%s)" % (name, suffix, types)
+                self.methods[selector(sig)] = lambda args, alg=alg: self.ha1(args, alg)
+
+    def name(self, arg):
+        if isinstance(arg, bytes):
+            return self.ids.get(arg.hex())
+        return arg
+
+    def ha1_of(self, args, alg):
+        user, realm = self.name(args[0]), self.name(args[1])
+        if user not in self.users or realm is None:
+            return None
+        return _h(alg, "%s:%s:%s" % (user, realm, self.password))
+
+    def ha1(self, args, alg):
+        ha1 = self.ha1_of(args, alg)
+        return None if ha1 is None else bytes.fromhex(ha1).ljust(32, b"\0")
+
+    def digest(self, args):
+        ha1 = self.ha1_of(args, "md5")
+        if ha1 is None:
+            return None
+        method, uri, nonce = args[2], args[3], args[4]
+        ha2 = _h("md5", "%s:%s" % (method, uri))
+        return bytes.fromhex(_h("md5", "%s:%s:%s" % (ha1, nonce, ha2))).ljust(32, b"\0")
+
+    def call(self, data):
+        data = bytes.fromhex(data[2:] if data.startswith("0x") else data)
+        fn = self.methods.get(data[:4].hex())
+        if fn is None:
+            raise ValueError("unknown method selector %s" % data[:4].hex())
+        return fn(decode_args(data[4:]))
+
+
+def decode_args(body):
+    """Decode a head of words: bytes32 values stay bytes, offsets are
+    followed to strings. Good enough for the module's argument lists."""
+    args = []
+    nwords = len(body) // 32
+    first_tail = nwords * 32
+    for i in range(nwords):
+        off = 32 * i
+        if off >= first_tail:
+            break
+        word = body[off:off + 32]
+        value = int.from_bytes(word, "big")
+        if value % 32 == 0 and 32 <= value < len(body) and value >= 32 * (i + 1):
+            length = int.from_bytes(body[value:value + 32], "big")
+            args.append(body[value + 32:value + 32 + length].decode("utf-8", "replace"))
+            first_tail = min(first_tail, value)
+        else:
+            args.append(word)
+    return args
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    contract = None
+    latency = 0.0
+    jitter = 0.0
+    calls = 0
+    lock = threading.Lock()
+
+    def log_message(self, *args):
+        pass
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        with Handler.lock:
+            Handler.calls += 1
+        try:
+            req = json.loads(body)
+            if req.get("method") != "eth_call":
+                raise ValueError("unsupported method %s" % req.get("method"))
+            result = self.contract.call(req["params"][0]["data"])
+            if result is None:
+                reply = {"jsonrpc": "2.0", "id": req.get("id"),
+                         "error": {"code": 3, "message": "execution reverted: User not found"}}
+            else:
+                reply = {"jsonrpc": "2.0", "id": req.get("id"), "result": "0x" + result.hex()}
+        except Exception as e:  # malformed requests are answered, not fatal
+            reply = {"jsonrpc": "2.0", "id": None, "error": {"code": -32602, "message": str(e)}}
+
+        delay = self.latency + (random.uniform(-self.jitter, self.jitter) if self.jitter else 0)
+        if delay > 0:
+            time.sleep(delay)
+
+        data = json.dumps(reply, separators=(",", ":")).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("--listen", default="127.0.0.1:18545", help="address:port")
+    p.add_argument("--users", type=int, default=1000, help="users user0000...")
+    p.add_argument("--password", default="secret")
+    p.add_argument("--realm", action="append", default=[],
+                   help="realm known to the ...ById methods (repeatable)")
+    p.add_argument("--latency", type=float, default=0.0, help="ms added per call")
+    p.add_argument("--jitter", type=float, default=0.0, help="+/- ms of random latency")
+    a = p.parse_args()
+
+    users = ["user%04d" % i for i in range(a.users)]
+    Handler.contract = Contract(users, a.password, a.realm or ["bench.local"])
+    Handler.latency = a.latency / 1000.0
+    Handler.jitter = a.jitter / 1000.0
+
+    host, port = a.listen.rsplit(":", 1)
+    server = ThreadingHTTPServer((host, int(port)), Handler)
+    server.daemon_threads = True
+    print("mock RPC listening on http://%s" % a.listen, file=sys.stderr, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("mock RPC served %d calls" % Handler.calls, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
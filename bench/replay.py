@@ -0,0 +1,454 @@
+#!/usr/bin/env python3
+"""Replay captured SIP authentication traffic against the module's caches.
+
+Reads a pcap/pcapng capture or a text SIP trace (ngrep, sngrep or any
+dump where messages follow a line with a date and time), keeps the
+REGISTER and INVITE requests with digest credentials and runs them through
+bench/replay/replay, which takes each one through the decisions the module
+makes using its own web3_cache.c, on the clock of the trace. Every
+combination of the swept HA1 cache sizes and TTLs is reported with its
+cache hit rate, contract call volume and time spent waiting for them.
+
+Retransmissions are dropped, as the transaction layer absorbs them before
+web3_auth runs. A request answered with 401, 403 or 407 counts as a wrong
+response, which makes the module refetch a cached HA1.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ENGINE = os.path.join(HERE, "replay", "build", "replay")
+
+# ----------------------------------------------------------------------------
+# Capture files
+
+PCAP_MAGIC = {b"\xd4\xc3\xb2\xa1": ("<", 1e-6), b"\xa1\xb2\xc3\xd4": (">", 1e-6),
+              b"\x4d\x3c\xb2\xa1": ("<", 1e-9), b"\xa1\xb2\x3c\x4d": (">", 1e-9)}
+PCAPNG_SHB = 0x0A0D0D0A
+
+
+def pcap_packets(f):
+    """(time, linktype, frame) of a classic pcap file."""
+    head = f.read(24)
+    endian, unit = PCAP_MAGIC[head[:4]]
+    linktype = struct.unpack(endian + "I", head[20:24])[0] & 0x0FFFFFFF
+    while True:
+        rec = f.read(16)
+        if len(rec) < 16:
+            return
+        sec, frac, incl, _ = struct.unpack(endian + "IIII", rec)
+        yield sec + frac * unit, linktype, f.read(incl)
+
+
+def pcapng_packets(f):
+    """(time, linktype, frame) of the enhanced and simple packet blocks."""
+    endian = "<"
+    ifaces = []
+    while True:
+        head = f.read(8)
+        if len(head) < 8:
+            return
+        btype = struct.unpack("<I", head[:4])[0]
+        if btype == PCAPNG_SHB:
+            body = f.read(4)
+            endian = "<" if body == b"\x4d\x3c\x2b\x1a" else ">"
+            length = struct.unpack(endian + "I", head[4:8])[0]
+            f.read(length - 12)
+            ifaces = []
+            continue
+        btype, length = struct.unpack(endian + "II", head)
+        body = f.read(length - 8)[:-4]
+        if btype == 1:                      # interface description
+            linktype = struct.unpack(endian + "H", body[:2])[0]
+            unit = 1e-6
+            opts = body[8:]
+            while len(opts) >= 4:
+                code, olen = struct.unpack(endian + "HH", opts[:4])
+                if code == 0:
+                    break
+                if code == 9:               # if_tsresol
+                    v = opts[4]
+                    unit = 2.0 ** -(v & 0x7F) if v & 0x80 else 10.0 ** -v
+                opts = opts[4 + ((olen + 3) & ~3):]
+            ifaces.append((linktype, unit))
+        elif btype == 6 and ifaces:         # enhanced packet
+            iface, hi, lo, incl = struct.unpack(endian + "IIII", body[:16])
+            linktype, unit = ifaces[iface]
+            yield ((hi << 32) | lo) * unit, linktype, body[20:20 + incl]
+        elif btype == 3 and ifaces:         # simple packet, no time stamp
+            yield None, ifaces[0][0], body[4:]
+
+
+def ip_payload(linktype, frame):
+    """(flow, protocol, payload) of a UDP or TCP packet, or None."""
+    if linktype == 1:                       # Ethernet
+        etype, off = struct.unpack("!H", frame[12:14])[0], 14
+        while etype in (0x8100, 0x88A8):    # VLAN tags
+            etype, off = struct.unpack("!H", frame[off + 2:off + 4])[0], off + 4
+    elif linktype == 113:                   # Linux cooked
+        etype, off = struct.unpack("!H", frame[14:16])[0], 16
+    elif linktype == 276:                   # Linux cooked v2
+        etype, off = struct.unpack("!H", frame[0:2])[0], 20
+    elif linktype in (0, 108):              # BSD loopback
+        family = struct.unpack("<I" if frame[0] else ">I", frame[:4])[0]
+        etype, off = (0x0800 if family == 2 else 0x86DD), 4
+    elif linktype in (101, 12, 14):         # raw IP
+        etype, off = (0x0800 if frame[0] >> 4 == 4 else 0x86DD), 0
+    else:
+        return None
+
+    if etype == 0x0800:
+        ihl = (frame[off] & 0x0F) * 4
+        total = struct.unpack("!H", frame[off + 2:off + 4])[0]
+        if struct.unpack("!H", frame[off + 6:off + 8])[0] & 0x3FFF:
+            return None                     # fragments are not reassembled
+        proto, src, dst = frame[off + 9], frame[off + 12:off + 16], frame[off + 16:off + 20]
+        end, off = off + total, off + ihl
+    elif etype == 0x86DD:
+        proto = frame[off + 6]
+        end = off + 40 + struct.unpack("!H", frame[off + 4:off + 6])[0]
+        src, dst, off = frame[off + 8:off + 24], frame[off + 24:off + 40], off + 40
+    else:
+        return None
+
+    if proto == 17:
+        sport, dport = struct.unpack("!HH", frame[off:off + 4])
+        return (src, sport, dst, dport), "udp", frame[off + 8:end]
+    if proto == 6:
+        sport, dport = struct.unpack("!HH", frame[off:off + 4])
+        return (src, sport, dst, dport), "tcp", frame[off + (frame[off + 12] >> 4) * 4:end]
+    return None
+
+
+def split_stream(buf):
+    """Complete SIP messages at the start of a TCP stream buffer, and the rest."""
+    msgs = []
+    while True:
+        while buf[:2] == b"\r\n":           # keepalives
+            buf = buf[2:]
+        end = buf.find(b"\r\n\r\n")
+        if end < 0:
+            return msgs, buf
+        m = re.search(rb"\r\n(?:content-length|l)[ \t]*:[ \t]*(\d+)", buf[:end], re.I)
+        total = end + 4 + (int(m.group(1)) if m else 0)
+        if len(buf) < total:
+            return msgs, buf
+        msgs.append(buf[:total])
+        buf = buf[total:]
+
+
+def capture_format(path):
+    """'pcap', 'pcapng' or None for anything else."""
+    with open(path, "rb") as f:
+        magic = f.read(4)
+    if magic in PCAP_MAGIC:
+        return "pcap"
+    if len(magic) == 4 and struct.unpack("<I", magic)[0] == PCAPNG_SHB:
+        return "pcapng"
+    return None
+
+
+def capture_messages(path, fmt):
+    """(time, message) of the SIP messages of a capture, in capture order."""
+    with open(path, "rb") as f:
+        packets = pcap_packets(f) if fmt == "pcap" else pcapng_packets(f)
+        streams = {}
+        last = 0.0
+        for ts, linktype, frame in packets:
+            last = ts if ts is not None else last
+            try:
+                parsed = ip_payload(linktype, frame)
+            except (IndexError, struct.error):
+                continue
+            if not parsed or not parsed[2]:
+                continue
+            flow, proto, data = parsed
+            if proto == "udp":
+                yield last, data
+                continue
+            msgs, streams[flow] = split_stream(streams.get(flow, b"") + data)
+            for m in msgs:
+                yield last, m
+
+
+# ----------------------------------------------------------------------------
+# Text traces
+
+START_LINE = re.compile(r"^(?:[A-Z]+ \S+ SIP/2\.0|SIP/2\.0 \d{3}\b)")
+DATE_TIME = re.compile(r"(\d{4})[/-](\d\d)[/-](\d\d)[ T](\d\d):(\d\d):(\d\d(?:\.\d+)?)")
+
+
+def text_messages(path, interval):
+    """(time, message) of a text trace; messages without a time stamp line
+    before them are spaced 'interval' seconds after the previous one."""
+    msgs = []
+    cur = None
+    ts = None
+    last = 0.0
+    with open(path, "r", errors="replace") as f:
+        for raw in f:
+            line = raw.rstrip("\r\n")
+            # ngrep and friends indent or prefix nothing; strip the common
+            # two space indent of sngrep dumps
+            body = line[2:] if line.startswith("  ") and START_LINE.match(line[2:]) else line
+            if START_LINE.match(body):
+                if cur:
+                    msgs.append(cur)
+                if ts is None:
+                    ts = last + interval
+                last = ts
+                cur = (ts, [body])
+                ts = None
+                continue
+            m = DATE_TIME.search(line)
+            if m and not (cur and ":" in line.split(" ", 1)[0]):
+                y, mo, d, h, mi, s = m.groups()
+                ts = time.mktime((int(y), int(mo), int(d), int(h), int(mi), 0, 0, 0, -1)) \
+                    + float(s)
+                if cur:
+                    msgs.append(cur)
+                    cur = None
+                continue
+            if cur:
+                cur[1].append(line)
+    if cur:
+        msgs.append(cur)
+    for ts, lines in msgs:
+        yield ts, "\r\n".join(lines).encode()
+
+
+# ----------------------------------------------------------------------------
+# SIP
+
+COMPACT = {"i": "call-id", "v": "via"}
+DIGEST_PARAM = re.compile(r'([A-Za-z-]+)\s*=\s*("(?:[^"\\]|\\.)*"|[^\s,]+)')
+
+
+def parse_sip(data):
+    """Start line and headers (lower case name -> list of values)."""
+    text = data.decode("utf-8", "replace")
+    head = text.split("\r\n\r\n", 1)[0].replace("\r\n", "\n")
+    lines = re.sub(r"\n[ \t]+", " ", head).split("\n")
+    headers = {}
+    for line in lines[1:]:
+        if ":" in line:
+            name, value = line.split(":", 1)
+            name = name.strip().lower()
+            headers.setdefault(COMPACT.get(name, name), []).append(value.strip())
+    return lines[0].strip(), headers
+
+
+def digest_params(value):
+    if not value.lower().startswith("digest"):
+        return None
+    params = {}
+    for name, v in DIGEST_PARAM.findall(value[6:]):
+        params[name.lower()] = v[1:-1] if v.startswith('"') else v
+    return params
+
+
+def auth_events(messages, methods):
+    """Authentication events of a message stream, with retransmissions
+    dropped and the outcome taken from the final response."""
+    events = []
+    pending = {}        # (call-id, cseq) -> event waiting for a final response
+    seen = set()
+    stats = {"messages": 0, "requests": 0, "retransmissions": 0, "no_credentials": 0}
+    for ts, data in messages:
+        try:
+            start, headers = parse_sip(data)
+        except ValueError:
+            continue
+        stats["messages"] += 1
+        call_id = (headers.get("call-id") or [""])[0]
+        cseq = (headers.get("cseq") or [""])[0]
+        if start.startswith("SIP/2.0"):
+            code = int(start.split()[1])
+            ev = pending.get((call_id, cseq))
+            if ev is not None and code >= 200:
+                ev["ok"] = 0 if code in (401, 403, 407) else 1
+                del pending[(call_id, cseq)]
+            continue
+
+        method = start.split(" ", 1)[0]
+        if method not in methods:
+            continue
+        stats["requests"] += 1
+        via = (headers.get("via") or [""])[0]
+        branch = re.search(r";\s*branch=([^;,\s]+)", via)
+        tid = (call_id, cseq, branch.group(1) if branch else via)
+        if tid in seen:
+            stats["retransmissions"] += 1
+            continue
+        seen.add(tid)
+
+        creds = None
+        for name in ("authorization", "proxy-authorization"):
+            for value in headers.get(name, []):
+                creds = digest_params(value)
+                if creds:
+                    break
+            if creds:
+                break
+        if not creds or "username" not in creds or "nonce" not in creds:
+            stats["no_credentials"] += 1
+            continue
+        ev = {"time": ts, "method": method, "username": creds["username"],
+              "realm": creds.get("realm", ""), "nonce": creds["nonce"],
+              "nc": creds.get("nc", ""), "qop": creds.get("qop", ""),
+              "algorithm": creds.get("algorithm", ""), "ok": 1}
+        events.append(ev)
+        pending[(call_id, cseq)] = ev
+
+    events.sort(key=lambda e: e["time"])
+    return events, stats
+
+
+def write_events(events, path):
+    with open(path, "w") as f:
+        for e in events:
+            fields = ["%.6f" % e["time"], e["method"], e["username"], e["realm"],
+                      e["nonce"], e["nc"], e["qop"], e["algorithm"], str(e["ok"])]
+            f.write("\t".join(v.replace("\t", " ") or "-" for v in fields) + "\n")
+
+
+# ----------------------------------------------------------------------------
+# RPC latency
+
+def measure_latency(url, count, user, realm):
+    """Round trips of getHA1(user, realm) eth_calls, in ms."""
+    sys.path.insert(0, HERE)
+    import mock_rpc
+
+    def word(n):
+        return "%064x" % n
+
+    def string(s):
+        b = s.encode()
+        return word(len(b)) + b.ljust((len(b) + 31) // 32 * 32, b"\0").hex()
+
+    u = string(user)
+    data = "0x" + mock_rpc.selector("getHA1(string,string)") + word(64) \
+        + word(64 + len(u) // 2) + u + string(realm)
+    body = json.dumps({"jsonrpc": "2.0", "method": "eth_call", "id": 1,
+                       "params": [{"to": "0x" + "00" * 20, "data": data}, "latest"]}).encode()
+    samples = []
+    for _ in range(count):
+        req = urllib.request.Request(url, body, {"Content-Type": "application/json"})
+        t = time.perf_counter()
+        with urllib.request.urlopen(req, timeout=30) as r:
+            r.read()
+        samples.append((time.perf_counter() - t) * 1000.0)
+    return samples
+
+
+# ----------------------------------------------------------------------------
+
+def int_list(text):
+    return [int(v) for v in text.split(",") if v]
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("trace", help="pcap, pcapng or text SIP trace")
+    p.add_argument("--engine", default=ENGINE, help="replay engine (make bench-replay builds it)")
+    p.add_argument("--method", action="append", default=[],
+                   help="request method to replay (default REGISTER and INVITE)")
+    p.add_argument("--interval", type=float, default=0.01,
+                   help="seconds between text trace messages without a time stamp")
+    p.add_argument("--cache-size", type=int_list, default=[0, 1024, 4096, 16384],
+                   help="ha1_cache_size values to sweep, comma separated")
+    p.add_argument("--ttl", type=int_list, default=[60, 300, 900],
+                   help="ha1_cache_ttl values to sweep, comma separated")
+    p.add_argument("--ha1-mode", type=int, choices=[0, 1], default=1,
+                   help="ha1_mode; with 0 only qop and SHA-2 credentials use the cache")
+    p.add_argument("--nc-cache-size", type=int, default=4096)
+    p.add_argument("--nonce-expire", type=int, default=300)
+    p.add_argument("--rpc-latency", type=float, default=5.0, help="ms per contract call")
+    p.add_argument("--rpc-url", help="measure contract call latency against this node "
+                   "(e.g. bench/mock_rpc.py) instead of using --rpc-latency")
+    p.add_argument("--rpc-samples", type=int, default=200, help="calls to measure")
+    p.add_argument("--rpc-user", default="user0000")
+    p.add_argument("--rpc-realm", default="bench.local")
+    p.add_argument("--seed", default="1", help="seed for picking measured latencies")
+    p.add_argument("--events", help="also write the extracted events to this file")
+    p.add_argument("--json", help="also write the results to this file")
+    a = p.parse_args()
+
+    if not os.access(a.engine, os.X_OK):
+        sys.exit("%s not found; run make bench-replay or pass --engine" % a.engine)
+
+    fmt = capture_format(a.trace)
+    if fmt:
+        messages = capture_messages(a.trace, fmt)
+    else:
+        messages = text_messages(a.trace, a.interval)
+    events, stats = auth_events(messages, set(a.method or ["REGISTER", "INVITE"]))
+    print("%(messages)d SIP messages, %(requests)d requests, %(retransmissions)d "
+          "retransmissions, %(no_credentials)d without credentials" % stats, file=sys.stderr)
+    if not events:
+        sys.exit("no authenticated requests in %s" % a.trace)
+    span = events[-1]["time"] - events[0]["time"]
+    print("%d authentications over %.1f s, %d users" % (
+        len(events), span, len({(e["username"], e["realm"]) for e in events})), file=sys.stderr)
+
+    tmp = tempfile.mkdtemp(prefix="web3_auth_replay.")
+    events_path = a.events or os.path.join(tmp, "events.tsv")
+    write_events(events, events_path)
+
+    common = ["-m", str(a.ha1_mode), "-n", str(a.nc_cache_size), "-e", str(a.nonce_expire),
+              "-l", str(a.rpc_latency), "-s", a.seed]
+    if a.rpc_url:
+        samples = measure_latency(a.rpc_url, a.rpc_samples, a.rpc_user, a.rpc_realm)
+        samples_path = os.path.join(tmp, "latency.txt")
+        with open(samples_path, "w") as f:
+            f.write("\n".join("%.3f" % s for s in samples) + "\n")
+        common += ["-L", samples_path]
+        samples.sort()
+        print("measured %d calls to %s: p50 %.2f ms, p99 %.2f ms" % (
+            len(samples), a.rpc_url, samples[len(samples) // 2],
+            samples[min(len(samples) - 1, int(0.99 * len(samples)))]), file=sys.stderr)
+
+    results = []
+    for size in a.cache_size:
+        for ttl in (a.ttl if size > 0 else a.ttl[:1]):
+            with open(events_path) as f:
+                out = subprocess.run([a.engine, "-c", str(size), "-t", str(ttl)] + common,
+                                     stdin=f, stdout=subprocess.PIPE, check=True).stdout
+            r = json.loads(out)
+            r.update({"ha1_cache_size": size, "ha1_cache_ttl": ttl if size > 0 else None})
+            results.append(r)
+
+    print("%10s %6s %8s %8s %9s %9s %9s %8s %8s %8s" % (
+        "cache", "ttl s", "hit %", "RPCs", "RPC/auth", "RPC/s", "peak/s",
+        "wait ms", "p90 ms", "p99 ms"))
+    for r in results:
+        print("%10s %6s %8.1f %8d %9.3f %9.2f %9d %8.2f %8.2f %8.2f" % (
+            r["ha1_cache_size"] or "off", r["ha1_cache_ttl"] or "-", 100 * r["hit_rate"],
+            r["rpcs"], r["rpcs_per_auth"], r["rpc_mean_per_s"], r["rpc_peak_per_s"],
+            r["wait_mean_ms"], r["wait_p90_ms"], r["wait_p99_ms"]))
+    r = results[0]
+    print("%d digest path, %d HA1 path, %d rejected, %d nonce-count replays, "
+          "%d stale nonces, %d unsupported algorithm"
+          % (r["digest_path"], r["ha1_path"], r["rejected"], r["nc_replays"],
+             r["nc_stale"], r["unsupported"]), file=sys.stderr)
+    if a.json:
+        with open(a.json, "w") as f:
+            json.dump({"trace": stats, "results": results}, f, indent=2)
+
+    for name in os.listdir(tmp):
+        os.unlink(os.path.join(tmp, name))
+    os.rmdir(tmp)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,22 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stand-in for core/dprint.h for the tools built outside Kamailio
+ * (bench/replay, fuzz): log to stderr, or nowhere with WEB3_NO_LOG
+ */
+
+#ifndef _REPLAY_DPRINT_H_
+#define _REPLAY_DPRINT_H_
+
+#include <stdio.h>
+
+#ifdef WEB3_NO_LOG
+#define LM_ERR(fmt, ...) do { } while (0)
+#define LM_WARN(fmt, ...) do { } while (0)
+#else
+#define LM_ERR(fmt, ...) fprintf(stderr, "ERROR: " fmt, ##__VA_ARGS__)
+#define LM_WARN(fmt, ...) fprintf(stderr, "WARNING: " fmt, ##__VA_ARGS__)
+#endif
+#define LM_INFO(fmt, ...) do { } while (0)
+#define LM_DBG(fmt, ...) do { } while (0)
+
+#endif
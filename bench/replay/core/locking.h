@@ -0,0 +1,29 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stand-in for the tools built outside Kamailio: core/locking.h
+ *
+ * The harness is a single process, so lock sets are empty.
+ */
+
+#ifndef _REPLAY_LOCKING_H_
+#define _REPLAY_LOCKING_H_
+
+#include <stdlib.h>
+
+typedef struct gen_lock_set {
+    int size;
+} gen_lock_set_t;
+
+static inline gen_lock_set_t* lock_set_alloc(int n) {
+    gen_lock_set_t* s = malloc(sizeof(gen_lock_set_t));
+    if (s) s->size = n;
+    return s;
+}
+
+#define lock_set_init(s) (s)
+#define lock_set_destroy(s) do { } while (0)
+#define lock_set_dealloc(s) free(s)
+#define lock_set_get(s, i) do { (void)(s); (void)(i); } while (0)
+#define lock_set_release(s, i) do { (void)(s); (void)(i); } while (0)
+
+#endif
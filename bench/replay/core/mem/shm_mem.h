@@ -0,0 +1,17 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stand-in for the tools built outside Kamailio: core/mem/shm_mem.h
+ */
+
+#ifndef _REPLAY_SHM_MEM_H_
+#define _REPLAY_SHM_MEM_H_
+
+#include <stdlib.h>
+
+#include "../dprint.h"
+
+#define shm_malloc(size) malloc(size)
+#define shm_free(p) free(p)
+#define SHM_MEM_ERROR LM_ERR("could not allocate shared memory\n")
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stand-in for the tools built outside Kamailio: core/str.h
+ */
+
+#ifndef _REPLAY_STR_H_
+#define _REPLAY_STR_H_
+
+typedef struct _str {
+    char* s;
+    int len;
+} str;
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Replay engine: feed recorded credentials through the module's caches
+ *
+ * Reads one authentication per line from stdin, as written by
+ * bench/replay.py, and takes each through the decisions web3_auth_run()
+ * and verify_with_ha1() make: digest path or HA1 path, HA1 cache lookup
+ * and refetch on mismatch, nonce-count check. The caches are the
+ * module's own web3_cache.c, the clock is the one of the trace, and every
+ * contract call costs a latency drawn from a fixed value or from samples
+ * measured against an RPC node, so a run is deterministic.
+ *
+ * Input fields, tab separated:
+ *   time method username realm nonce nc qop algorithm ok
+ * 'time' is in seconds, 'ok' is 0 when the request was rejected.
+ *
+ * Output is one JSON object with the counters of the run.
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "web3_cache.h"
+
+#define MAX_LINE 4096
+#define MAX_FIELDS 9
+#define MD5_HEX_LEN 32
+#define MAX_DIGEST_HEX_LEN 64
+
+enum { F_TIME, F_METHOD, F_USER, F_REALM, F_NONCE, F_NC, F_QOP, F_ALG, F_OK };
+
+// Same order as digest_alg_t, the index is part of the HA1 cache key
+static const char* const digest_algs[] = {"MD5", "SHA-256", "SHA-512-256"};
+
+static struct {
+    int ha1_mode;
+    int ha1_cache_size;
+    int ha1_cache_ttl;
+    int nc_cache_size;
+    int nonce_expire;
+    double rpc_latency;         // ms per contract call without samples
+    double* samples;            // measured ms per contract call
+    int nsamples;
+    uint64_t seed;
+} cfg = {1, 4096, 300, 4096, 300, 5.0, NULL, 0, 0x9e3779b97f4a7c15ULL};
+
+static struct {
+    unsigned long auths;
+    unsigned long digest_path;
+    unsigned long ha1_path;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long rpcs;
+    unsigned long rejected;
+    unsigned long nc_replays;
+    unsigned long nc_stale;     // new nonces the nc cache had no room for
+    unsigned long unsupported;
+    unsigned long rpc_peak;     // contract calls in the busiest second
+    double first;
+    double last;
+} st;
+
+static double* latencies;
+static size_t nlat, lat_size;
+
+static uint64_t rng_state;
+
+// xorshift64*, only to pick latency samples reproducibly
+static double rpc_cost(void) {
+    uint64_t x = rng_state;
+
+    if (cfg.nsamples == 0) return cfg.rpc_latency;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng_state = x;
+    return cfg.samples[((x * 0x2545F4914F6CDD1DULL) >> 32) % (uint64_t)cfg.nsamples];
+}
+
+static unsigned long rpc_second_count;
+static unsigned int rpc_second = (unsigned int)-1;
+
+static double rpc_call(unsigned int now) {
+    if (now != rpc_second) {
+        rpc_second = now;
+        rpc_second_count = 0;
+    }
+    if (++rpc_second_count > st.rpc_peak) st.rpc_peak = rpc_second_count;
+    st.rpcs++;
+    return rpc_cost();
+}
+
+static int load_samples(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[128];
+    int size = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char* end;
+        double v = strtod(line, &end);
+        if (end == line || v < 0) continue;
+        if (cfg.nsamples == size) {
+            size = size ? size * 2 : 256;
+            cfg.samples = realloc(cfg.samples, size * sizeof(double));
+            if (!cfg.samples) {
+                fclose(f);
+                return -1;
+            }
+        }
+        cfg.samples[cfg.nsamples++] = v;
+    }
+    fclose(f);
+    if (cfg.nsamples == 0) {
+        fprintf(stderr, "%s: no latency samples\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int record_latency(double ms) {
+    if (nlat == lat_size) {
+        lat_size = lat_size ? lat_size * 2 : 4096;
+        latencies = realloc(latencies, lat_size * sizeof(double));
+        if (!latencies) return -1;
+    }
+    latencies[nlat++] = ms;
+    return 0;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(double q) {
+    if (nlat == 0) return 0;
+    size_t i = (size_t)(q * nlat);
+    return latencies[i < nlat ? i : nlat - 1];
+}
+
+static int digest_alg(const str* name) {
+    if (name->len == 0) return 0;
+    for (int i = 0; i < (int)(sizeof(digest_algs) / sizeof(digest_algs[0])); i++) {
+        if ((int)strlen(digest_algs[i]) == name->len
+                && strncasecmp(name->s, digest_algs[i], name->len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// HA1 cache key as built by ha1_cache_key() for the default ha1_args
+// (username, realm)
+static int ha1_key(int alg, const str* user, const str* realm, char* buf, str* key) {
+    int len = 1 + user->len + 1 + realm->len;
+
+    if (len > WEB3_CACHE_KEY_SIZE) return -1;
+    buf[0] = (char)('0' + alg);
+    memcpy(buf + 1, user->s, user->len);
+    buf[1 + user->len] = '\0';
+    memcpy(buf + 2 + user->len, realm->s, realm->len);
+    key->s = buf;
+    key->len = len;
+    return 0;
+}
+
+// One authentication; returns the time spent waiting for the contract
+static double replay_auth(web3_cache_t* ha1_cache, web3_cache_t* nc_cache,
+        str* f, unsigned int now) {
+    char ha1[MAX_DIGEST_HEX_LEN] = {0};
+    char key_buf[WEB3_CACHE_KEY_SIZE];
+    str key = {0, 0};
+    int ok = !(f[F_OK].len == 1 && f[F_OK].s[0] == '0');
+    int alg = digest_alg(&f[F_ALG]);
+    int cached = 0;
+    double wait = 0;
+
+    if (alg < 0) {
+        st.unsupported++;
+        return 0;
+    }
+
+    if (!(cfg.ha1_mode || f[F_QOP].len > 0 || alg != 0)) {
+        // getDigestHash() answers for every request
+        st.digest_path++;
+        if (!ok) st.rejected++;
+        return rpc_call(now);
+    }
+
+    st.ha1_path++;
+    if (ha1_cache) {
+        if (ha1_key(alg, &f[F_USER], &f[F_REALM], key_buf, &key) == 0
+                && web3_cache_get(ha1_cache, &key, now, ha1) == 0) {
+            cached = 1;
+        }
+        if (cached) st.hits++; else st.misses++;
+    }
+    if (!cached) {
+        wait += rpc_call(now);
+        if (key.len > 0) web3_cache_put(ha1_cache, &key, now + cfg.ha1_cache_ttl, ha1);
+    }
+
+    if (!ok) {
+        // A cached HA1 that does not match is refetched once
+        if (cached) {
+            web3_cache_remove(ha1_cache, &key);
+            st.misses++;
+            wait += rpc_call(now);
+            web3_cache_put(ha1_cache, &key, now + cfg.ha1_cache_ttl, ha1);
+        }
+        st.rejected++;
+        return wait;
+    }
+
+    if (f[F_QOP].len > 0 && nc_cache) {
+        unsigned int nc = (unsigned int)strtoul(f[F_NC].s, NULL, 16);
+        int ret = web3_cache_nc_check(nc_cache, &f[F_NONCE], nc, now,
+                now + cfg.nonce_expire);
+        if (ret == 0) {
+            st.nc_replays++;
+        } else if (ret < 0) {
+            st.nc_stale++;
+        }
+    }
+    return wait;
+}
+
+static int split_fields(char* line, str* f) {
+    int n = 0;
+    char* p = line;
+
+    for (;;) {
+        char* tab = strchr(p, '\t');
+        if (n == MAX_FIELDS) return -1;
+        f[n].s = p;
+        f[n].len = tab ? (int)(tab - p) : (int)strlen(p);
+        if (f[n].len == 1 && p[0] == '-') f[n].len = 0;
+        n++;
+        if (!tab) break;
+        *tab = '\0';
+        p = tab + 1;
+    }
+    return n == MAX_FIELDS ? 0 : -1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+        "usage: %s [options] < events\n"
+        "  -m 0|1   ha1_mode (default 1)\n"
+        "  -c N     ha1_cache_size, 0 disables the cache (default 4096)\n"
+        "  -t S     ha1_cache_ttl in seconds (default 300)\n"
+        "  -n N     nc_cache_size (default 4096)\n"
+        "  -e S     nonce_expire in seconds (default 300)\n"
+        "  -l MS    latency of a contract call (default 5)\n"
+        "  -L FILE  measured latencies in ms, one per line, used instead of -l\n"
+        "  -s SEED  seed for picking latency samples\n", name);
+}
+
+int main(int argc, char** argv) {
+    web3_cache_t* ha1_cache = NULL;
+    web3_cache_t* nc_cache = NULL;
+    char line[MAX_LINE];
+    str f[MAX_FIELDS];
+    unsigned long lineno = 0;
+    double sum = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:c:t:n:e:l:L:s:h")) != -1) {
+        switch (opt) {
+            case 'm': cfg.ha1_mode = atoi(optarg); break;
+            case 'c': cfg.ha1_cache_size = atoi(optarg); break;
+            case 't': cfg.ha1_cache_ttl = atoi(optarg); break;
+            case 'n': cfg.nc_cache_size = atoi(optarg); break;
+            case 'e': cfg.nonce_expire = atoi(optarg); break;
+            case 'l': cfg.rpc_latency = atof(optarg); break;
+            case 'L': if (load_samples(optarg) < 0) return 1; break;
+            case 's': cfg.seed = strtoull(optarg, NULL, 0) | 1; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    rng_state = cfg.seed;
+
+    if (cfg.ha1_cache_size > 0) {
+        ha1_cache = web3_cache_new(cfg.ha1_cache_size, MAX_DIGEST_HEX_LEN);
+        if (!ha1_cache) return 1;
+    }
+    if (cfg.nc_cache_size > 0) {
+        nc_cache = web3_cache_new(cfg.nc_cache_size, sizeof(unsigned int));
+        if (!nc_cache) return 1;
+    }
+
+    while (fgets(line, sizeof(line), stdin)) {
+        double t, ms;
+        size_t len = strlen(line);
+
+        lineno++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+        if (split_fields(line, f) < 0) {
+            fprintf(stderr, "line %lu: expected %d fields\n", lineno, MAX_FIELDS);
+            return 1;
+        }
+        t = strtod(f[F_TIME].s, NULL);
+        if (st.auths == 0) st.first = t;
+        st.last = t;
+        st.auths++;
+
+        ms = replay_auth(ha1_cache, nc_cache, f, (unsigned int)t);
+        sum += ms;
+        if (record_latency(ms) < 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    qsort(latencies, nlat, sizeof(double), cmp_double);
+    double span = st.last - st.first;
+    printf("{\"auths\": %lu, \"digest_path\": %lu, \"ha1_path\": %lu, "
+            "\"hits\": %lu, \"misses\": %lu, \"hit_rate\": %.4f, "
+            "\"rpcs\": %lu, \"rpcs_per_auth\": %.4f, \"rpc_mean_per_s\": %.2f, "
+            "\"rpc_peak_per_s\": %lu, \"rejected\": %lu, \"nc_replays\": %lu, "
+            "\"nc_stale\": %lu, \"unsupported\": %lu, \"wait_mean_ms\": %.3f, "
+            "\"wait_p50_ms\": %.3f, \"wait_p90_ms\": %.3f, \"wait_p99_ms\": %.3f}\n",
+            st.auths, st.digest_path, st.ha1_path,
+            st.hits, st.misses,
+            st.hits + st.misses ? (double)st.hits / (st.hits + st.misses) : 0.0,
+            st.rpcs, st.auths ? (double)st.rpcs / st.auths : 0.0,
+            span > 0 ? st.rpcs / span : (double)st.rpcs,
+            st.rpc_peak, st.rejected, st.nc_replays, st.nc_stale,
+            st.unsupported, nlat ? sum / nlat : 0.0, percentile(0.50),
+            percentile(0.90), percentile(0.99));
+
+    web3_cache_destroy(ha1_cache);
+    web3_cache_destroy(nc_cache);
+    free(latencies);
+    free(cfg.samples);
+    return 0;
+}
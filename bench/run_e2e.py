@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""End-to-end benchmark: Kamailio with web3_auth, the mock RPC and SIPp.
+
+For each configuration variant a Kamailio config is generated from
+kamailio_web3_sample.cfg, Kamailio is started against bench/mock_rpc.py
+and every SIPp scenario is run against it. Reported per run: successful
+calls per second, latency percentiles of the authenticated request and
+Kamailio CPU time per authentication.
+"""
+
+import argparse
+import glob
+import json
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+import gen_config  # noqa: E402
+
+# name -> web3_auth parameters; each mode to compare gets a line.
+# "async_workers" is not one: it runs the checks with web3_auth_check_async()
+# in that many async workers (see gen_config.make_async())
+VARIANTS = {
+    "digest": [],                                   # contract computes the response
+    "ha1-cache": [("ha1_mode", "1")],               # local check, HA1 cached
+    "ha1-nocache": [("ha1_mode", "1"), ("ha1_cache_size", "0")],
+    "async": [("async_workers", "8")],              # digest, off the SIP processes
+}
+
+SCENARIOS = ["register", "invite"]
+
+DEFAULT_MPATH = "/usr/lib/x86_64-linux-gnu/kamailio/modules:/usr/lib64/kamailio/modules:" \
+                "/usr/lib/kamailio/modules:/usr/local/lib64/kamailio/modules:" \
+                "/usr/local/lib/kamailio/modules"
+
+
+def cpu_ticks(root_pid):
+    """utime + stime of a process and its direct children, in clock ticks."""
+    total = 0
+    for stat in glob.glob("/proc/[0-9]*/stat"):
+        try:
+            with open(stat) as f:
+                data = f.read()
+        except OSError:
+            continue
+        pid = int(stat.split("/")[2])
+        fields = data[data.rindex(")") + 2:].split()
+        ppid = int(fields[1])
+        if pid == root_pid or ppid == root_pid:
+            total += int(fields[11]) + int(fields[12])
+    return total
+
+
+def percentile(values, q):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def read_rtt(directory):
+    """Response times (ms) of the "auth" timer from SIPp's -trace_rtt files."""
+    times = []
+    for path in glob.glob(os.path.join(directory, "*_rtt.csv")):
+        with open(path) as f:
+            header = f.readline().strip().split(";")
+            col = next((i for i, h in enumerate(header) if "response_time" in h), 1)
+            for line in f:
+                parts = line.strip().split(";")
+                if len(parts) > col:
+                    try:
+                        times.append(float(parts[col]))
+                    except ValueError:
+                        pass
+        os.unlink(path)
+    return times
+
+
+def wait_started(proc, seconds):
+    """Give Kamailio time to start; False if it exited meanwhile."""
+    deadline = time.time() + seconds
+    while time.time() < deadline:
+        if proc.poll() is not None:
+            return False
+        time.sleep(0.1)
+    return True
+
+
+def run_sipp(a, scenario, workdir, users_csv):
+    cmd = [a.sipp, "-sf", os.path.join(HERE, "scenarios", scenario + ".xml"),
+           "-inf", users_csv, "-i", "127.0.0.1",
+           "-r", str(a.rate), "-l", str(a.limit), "-m", str(a.calls),
+           "-t", "u1" if a.transport == "udp" else "t1",
+           "-trace_rtt", "-rtt_freq", "1",
+           "-timeout", "%ds" % (a.calls // max(a.rate, 1) * 3 + 30), "-timeout_error",
+           "-nostdin", a.listen]
+    start = time.time()
+    with open(os.path.join(workdir, scenario + ".sipp.log"), "w") as log:
+        rc = subprocess.call(cmd, cwd=workdir, stdout=log, stderr=subprocess.STDOUT)
+    elapsed = time.time() - start
+    if rc not in (0, 1):
+        print("sipp failed (exit %d), see %s" % (rc, log.name), file=sys.stderr)
+    return elapsed, read_rtt(workdir)
+
+
+def run_variant(a, name, params, workdir, users_csv, mpath):
+    runtime = os.path.join(workdir, name)
+    os.makedirs(runtime, exist_ok=True)
+    cfg_path = os.path.join(runtime, "kamailio.cfg")
+    params = params + a.modparam
+    workers = int(dict(params).get("async_workers", 0))
+    params = [(k, v) for k, v in params if k != "async_workers"]
+    cfg = gen_config.generate(a.sample, a.listen, a.rpc_url, mpath, runtime,
+                              a.children, params, a.debug, workers)
+    with open(cfg_path, "w") as f:
+        f.write(cfg)
+
+    log = open(os.path.join(runtime, "kamailio.log"), "w")
+    kam = subprocess.Popen([a.kamailio, "-f", cfg_path, "-DD", "-E"],
+                           stdout=log, stderr=subprocess.STDOUT, start_new_session=True)
+    results = []
+    try:
+        if not wait_started(kam, a.startup):
+            print("%s: kamailio exited, see %s" % (name, log.name), file=sys.stderr)
+            return results
+        for scenario in a.scenario:
+            cpu0 = cpu_ticks(kam.pid)
+            elapsed, times = run_sipp(a, scenario, runtime, users_csv)
+            cpu = (cpu_ticks(kam.pid) - cpu0) / os.sysconf("SC_CLK_TCK")
+            ok = len(times)
+            results.append({
+                "variant": name, "scenario": scenario,
+                "mode": "async/%d" % workers if workers else "sync",
+                "ok": ok, "failed": a.calls - ok,
+                "cps": ok / elapsed if elapsed > 0 else 0.0,
+                "p50_ms": percentile(times, 0.50),
+                "p90_ms": percentile(times, 0.90),
+                "p99_ms": percentile(times, 0.99),
+                # one web3_auth check per call: the first request has no credentials
+                "cpu_us_per_auth": cpu * 1e6 / ok if ok else float("nan"),
+            })
+    finally:
+        os.killpg(kam.pid, signal.SIGTERM)
+        try:
+            kam.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            os.killpg(kam.pid, signal.SIGKILL)
+            kam.wait()
+        log.close()
+    return results
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("--kamailio", default="kamailio")
+    p.add_argument("--sipp", default="sipp")
+    p.add_argument("--module", default="web3_auth.so", help="built module to load")
+    p.add_argument("--mpath", default=DEFAULT_MPATH, help="Kamailio module directories")
+    p.add_argument("--sample", default=gen_config.SAMPLE)
+    p.add_argument("--listen", default="127.0.0.1:5080")
+    p.add_argument("--transport", choices=["udp", "tcp"], default="udp")
+    p.add_argument("--rpc-listen", default="127.0.0.1:18545")
+    p.add_argument("--rpc-latency", type=float, default=5.0, help="ms per mock eth_call")
+    p.add_argument("--users", type=int, default=1000)
+    p.add_argument("--children", type=int, default=8)
+    p.add_argument("--calls", type=int, default=5000, help="calls per scenario")
+    p.add_argument("--rate", type=int, default=200, help="new calls per second")
+    p.add_argument("--limit", type=int, default=200, help="max simultaneous calls")
+    p.add_argument("--startup", type=float, default=2.0, help="seconds to let Kamailio start")
+    p.add_argument("--debug", type=int, default=1, help="Kamailio debug level")
+    p.add_argument("--variant", action="append", default=[],
+                   help="variant to run (%s), or NAME:param=value,... for a custom one;"
+                   " async_workers=N makes it async" % ", ".join(VARIANTS))
+    p.add_argument("--scenario", action="append", choices=SCENARIOS, default=[])
+    p.add_argument("--modparam", action="append", default=[], metavar="NAME=VALUE",
+                   help="web3_auth parameter added to every variant")
+    p.add_argument("--json", help="also write the results to this file")
+    p.add_argument("--keep", action="store_true", help="keep configs and logs")
+    a = p.parse_args()
+
+    a.scenario = a.scenario or SCENARIOS
+    a.modparam = [tuple(mp.split("=", 1)) for mp in a.modparam]
+    a.rpc_url = "http://%s/" % a.rpc_listen
+    for tool in (a.kamailio, a.sipp):
+        if not shutil.which(tool):
+            sys.exit("%s not found; set KAMAILIO= / SIPP= or install it" % tool)
+    if not os.path.exists(a.module):
+        sys.exit("module %s not found; build it first" % a.module)
+
+    variants = []
+    for v in a.variant or list(VARIANTS):
+        if ":" in v:
+            name, spec = v.split(":", 1)
+            variants.append((name, [tuple(kv.split("=", 1)) for kv in spec.split(",") if kv]))
+        elif v in VARIANTS:
+            variants.append((v, VARIANTS[v]))
+        else:
+            sys.exit("unknown variant %s" % v)
+
+    workdir = tempfile.mkdtemp(prefix="web3_auth_bench.")
+    # loadmodule "web3_auth.so" looks the module up by that name
+    moddir = os.path.join(workdir, "modules")
+    os.makedirs(moddir)
+    os.symlink(os.path.abspath(a.module), os.path.join(moddir, "web3_auth.so"))
+    mpath = moddir + ":" + a.mpath
+
+    users_csv = os.path.join(workdir, "users.csv")
+    with open(users_csv, "w") as f:
+        f.write("RANDOM\n")
+        for i in range(a.users):
+            f.write("user%04d;secret;bench.local\n" % i)
+
+    mock = subprocess.Popen([sys.executable, os.path.join(HERE, "mock_rpc.py"),
+                             "--listen", a.rpc_listen, "--users", str(a.users),
+                             "--password", "secret", "--latency", str(a.rpc_latency)])
+    results = []
+    try:
+        time.sleep(0.5)
+        for name, params in variants:
+            print("== %s" % name, file=sys.stderr, flush=True)
+            results += run_variant(a, name, params, workdir, users_csv, mpath)
+    finally:
+        mock.send_signal(signal.SIGINT)
+        mock.wait()
+
+    print("%-14s %-9s %-8s %7s %7s %9s %8s %8s %8s %12s" % (
+        "variant", "scenario", "mode", "ok", "failed", "calls/s", "p50 ms", "p90 ms",
+        "p99 ms", "CPU us/auth"))
+    for r in results:
+        print("%-14s %-9s %-8s %7d %7d %9.1f %8.2f %8.2f %8.2f %12.1f" % (
+            r["variant"], r["scenario"], r["mode"], r["ok"], r["failed"], r["cps"],
+            r["p50_ms"], r["p90_ms"], r["p99_ms"], r["cpu_us_per_auth"]))
+    if a.json:
+        with open(a.json, "w") as f:
+            json.dump(results, f, indent=2)
+
+    if a.keep:
+        print("configs and logs kept in %s" % workdir, file=sys.stderr)
+    else:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stand-alone runner for the fuzz targets, for compilers without libFuzzer
+ *
+ * Runs the target on each file given (a corpus or a crash to reproduce),
+ * then on random inputs: -n inputs of up to -m bytes from seed -s.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "fuzz.h"
+
+__attribute__((weak)) int LLVMFuzzerInitialize(int* argc, char*** argv);
+
+static uint64_t rng;
+
+static uint64_t next(void) {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
+
+static int run_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    static uint8_t buf[1 << 20];
+    size_t n;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(buf, n);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long runs = 10000, max_len = 1024;
+    uint64_t seed = 1;
+    uint8_t* buf;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:s:")) != -1) {
+        switch (opt) {
+            case 'n': runs = strtoul(optarg, NULL, 0); break;
+            case 'm': max_len = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n runs] [-m max_len] [-s seed] [file...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (LLVMFuzzerInitialize) LLVMFuzzerInitialize(&argc, &argv);
+
+    for (int i = optind; i < argc; i++) {
+        if (run_file(argv[i]) < 0) return 1;
+    }
+
+    buf = malloc(max_len + 1);
+    if (!buf) return 1;
+    rng = seed * 0x9E3779B97F4A7C15ULL | 1;
+    for (unsigned long r = 0; r < runs; r++) {
+        // mostly short inputs, some up to max_len
+        size_t len = next() % (r % 8 ? 128 : max_len + 1);
+        for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(next() >> 56);
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    free(buf);
+    fprintf(stderr, "%s: %lu random inputs and %d files passed\n", argv[0], runs,
+            argc - optind);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared bits of the fuzz targets
+ *
+ * Every target defines LLVMFuzzerTestOneInput() and aborts on a
+ * divergence, so it runs under libFuzzer (make fuzz) as well as under
+ * driver.c on random inputs (make fuzz-check).
+ */
+
+#ifndef _FUZZ_H_
+#define _FUZZ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FUZZ_CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n  ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            abort(); \
+        } \
+    } while (0)
+
+// Consume input bytes front to back; reads past the end give zeros
+typedef struct fuzz_input {
+    const uint8_t* data;
+    size_t size;
+} fuzz_input_t;
+
+static inline uint8_t fuzz_byte(fuzz_input_t* in) {
+    if (in->size == 0) return 0;
+    in->size--;
+    return *in->data++;
+}
+
+// Take up to 'len' bytes; returns how many were taken
+static inline size_t fuzz_bytes(fuzz_input_t* in, size_t len, const uint8_t** out) {
+    if (len > in->size) len = in->size;
+    *out = in->data;
+    in->data += len;
+    in->size -= len;
+    return len;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Fuzz target: web3_abi_parse() and web3_abi_encode() against
+ * ref_abi_encode(), and decoding of what was encoded
+ *
+ * The input picks argument types and values. Values are raw bytes, 0x hex
+ * numbers, decimal numbers or bool words, so random inputs reach the
+ * accepting paths of every type as well as the rejecting ones.
+ */
+
+#include <string.h>
+
+#include "fuzz.h"
+#include "ref_abi.h"
+#include "web3_abi.h"
+#include "web3_hex.h"
+
+#define MAX_ARGS 8
+#define MAX_VALUE 96
+
+static const char* const bool_words[] = {"0", "1", "true", "False", "TRUE", "yes", "", "2"};
+
+// Build a value for one argument in 'buf'; returns its length
+static int make_value(fuzz_input_t* in, char* buf) {
+    const uint8_t* raw;
+    uint8_t mode = fuzz_byte(in);
+    int len = 0;
+
+    switch (mode % 4) {
+        case 0:
+            len = (int)fuzz_bytes(in, fuzz_byte(in) % MAX_VALUE, &raw);
+            memcpy(buf, raw, len);
+            break;
+        case 1: {
+            // 0x number with 0..44 digits, some with leading zeros
+            int digits = fuzz_byte(in) % 45;
+            buf[len++] = '0';
+            buf[len++] = (mode & 0x10) ? 'X' : 'x';
+            for (int i = 0; i < digits; i++) {
+                uint8_t b = fuzz_byte(in);
+                buf[len++] = (mode & 0x20) && i < 4 ? '0'
+                    : "0123456789abcdefABCDEF"[b % 22];
+            }
+            break;
+        }
+        case 2: {
+            unsigned long long v = 0;
+            for (int i = 0; i < 8; i++) v = (v << 8) | fuzz_byte(in);
+            v >>= fuzz_byte(in) % 64;
+            len = snprintf(buf, MAX_VALUE, (mode & 0x10) ? "00%llu" : "%llu", v);
+            if (mode & 0x20) len = snprintf(buf, MAX_VALUE, "%llu9", v);
+            break;
+        }
+        default:
+            len = snprintf(buf, MAX_VALUE, "%s", bool_words[(mode >> 2) % 8]);
+            break;
+    }
+    return len;
+}
+
+static void make_type(fuzz_input_t* in, char* type) {
+    uint8_t t = fuzz_byte(in);
+
+    switch (t % 6) {
+        case 0: strcpy(type, "string"); break;
+        case 1: strcpy(type, "bytes"); break;
+        case 2: sprintf(type, "bytes%d", 1 + fuzz_byte(in) % 32); break;
+        case 3: sprintf(type, "uint%d", 8 * (1 + fuzz_byte(in) % 32)); break;
+        case 4: strcpy(type, "address"); break;
+        default: strcpy(type, "bool"); break;
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzz_input_t in = {data, size};
+    char types[MAX_ARGS][16];
+    char values[MAX_ARGS][MAX_VALUE + 8];
+    ref_abi_value_t ref_args[MAX_ARGS];
+    str vals[MAX_ARGS];
+    char signature[WEB3_ABI_MAX_SIGNATURE];
+    char canonical[WEB3_ABI_MAX_SIGNATURE];
+    web3_abi_method_t m;
+    int nargs = fuzz_byte(&in) % (MAX_ARGS + 1);
+    int sig_len, canon_len;
+    uint8_t spaces = fuzz_byte(&in);
+
+    // Signature with optional spaces the parser has to skip, and its
+    // canonical form
+    sig_len = snprintf(signature, sizeof(signature), "%sfn_%d(", spaces & 1 ? " " : "", nargs);
+    canon_len = snprintf(canonical, sizeof(canonical), "fn_%d(", nargs);
+    for (int i = 0; i < nargs; i++) {
+        make_type(&in, types[i]);
+        sig_len += snprintf(signature + sig_len, sizeof(signature) - sig_len, "%s%s%s",
+                i ? (spaces & 2 ? " , " : ",") : (spaces & 4 ? " " : ""), types[i],
+                spaces & 8 ? " " : "");
+        canon_len += snprintf(canonical + canon_len, sizeof(canonical) - canon_len, "%s%s",
+                i ? "," : "", types[i]);
+    }
+    snprintf(signature + sig_len, sizeof(signature) - sig_len, ")");
+    snprintf(canonical + canon_len, sizeof(canonical) - canon_len, ")");
+
+    FUZZ_CHECK(web3_abi_parse(signature, &m) == 0, "parse of '%s' failed", signature);
+    FUZZ_CHECK(strcmp(m.signature, canonical) == 0, "'%s' parsed as '%s'", signature,
+            m.signature);
+    FUZZ_CHECK(m.nargs == nargs, "'%s': %d args", signature, m.nargs);
+
+    for (int i = 0; i < nargs; i++) {
+        vals[i].s = values[i];
+        vals[i].len = make_value(&in, values[i]);
+        ref_args[i].type = types[i];
+        ref_args[i].data = (const uint8_t*)values[i];
+        ref_args[i].len = vals[i].len;
+    }
+
+    int len = web3_abi_encoded_len(&m, vals);
+    // exactly sized, so the sanitizers see any write past the end
+    char* out = malloc(len);
+    char* ref = malloc(len + 1);
+    FUZZ_CHECK(out && ref, "out of memory");
+
+    int ret = web3_abi_encode(&m, vals, out);
+    char name[16];
+    snprintf(name, sizeof(name), "fn_%d", nargs);
+    int ref_ret = ref_abi_encode(name, ref_args, nargs, ref, len + 1);
+
+    if (ret < 0 || ref_ret < 0) {
+        if (!(ret < 0 && ref_ret < 0)) {
+            for (int i = 0; i < nargs; i++) {
+                fprintf(stderr, "  argument %d %s: '%.*s'\n", i, types[i], vals[i].len,
+                        vals[i].s);
+            }
+        }
+        FUZZ_CHECK(ret < 0 && ref_ret < 0, "%s: web3_abi_encode %d, reference %d",
+                canonical, ret, ref_ret);
+        goto done;
+    }
+
+    FUZZ_CHECK(ret == len, "%s: encoded %d chars, web3_abi_encoded_len %d", canonical,
+            ret, len);
+    FUZZ_CHECK(ref_ret == len && memcmp(out, ref, len) == 0,
+            "%s:\n  web3_abi  %.*s\n  reference %.*s", canonical, len, out, ref_ret, ref);
+
+    // Everything encoded decodes back
+    for (int i = 0; i < nargs; i++) {
+        if (m.args[i].type == WEB3_ABI_STRING || m.args[i].type == WEB3_ABI_BYTES) {
+            const char* hex;
+            int n;
+            uint8_t back[MAX_VALUE];
+            FUZZ_CHECK(ref_abi_decode_dynamic(out + 8, len - 8, i, &hex, &n) == 0,
+                    "%s: argument %d does not decode", canonical, i);
+            FUZZ_CHECK(n == vals[i].len && web3_hex_decode(hex, 2 * n, back) == 0
+                    && memcmp(back, vals[i].s, n) == 0,
+                    "%s: argument %d decodes to %d bytes, encoded %d", canonical, i, n,
+                    vals[i].len);
+        } else {
+            uint8_t word[32], want[32];
+            FUZZ_CHECK(web3_abi_decode_word(out + 8, len - 8, i, word) == 0
+                    && web3_hex_decode(ref + 8 + 64 * i, 64, want) == 0
+                    && memcmp(word, want, 32) == 0,
+                    "%s: word %d does not decode", canonical, i);
+        }
+    }
+
+done:
+    free(out);
+    free(ref);
+    return 0;
+}
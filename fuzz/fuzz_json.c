@@ -0,0 +1,100 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Fuzz target: web3_json_result() against the strstr() based extraction
+ * the module used before, and web3_json_result_scan() on the body split
+ * into chunks against web3_json_result() on the whole body
+ *
+ * The first input bytes choose where the "result":" pattern and a
+ * closing quote are spliced into the body and where it is split.
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "fuzz.h"
+#include "web3_json.h"
+
+#define PATTERN "\"result\":\""
+#define MAX_BODY 4096
+#define MAX_CHUNKS 8
+
+// The original extract_result(): first pattern, up to the next quote
+static const char* ref_extract(const char* json, size_t* len) {
+    const char* start = strstr(json, PATTERN);
+    const char* end;
+
+    if (!start) return NULL;
+    start += strlen(PATTERN);
+    end = strchr(start, '"');
+    if (!end) return NULL;
+    *len = end - start;
+    return start;
+}
+
+static size_t splice(char* body, size_t len, size_t pos, const char* s) {
+    size_t n = strlen(s);
+    if (len + n > MAX_BODY) return len;
+    pos = len ? pos % (len + 1) : 0;
+    memmove(body + pos + n, body + pos, len - pos);
+    memcpy(body + pos, s, n);
+    return len + n;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzz_input_t in = {data, size};
+    static char body[MAX_BODY + 1];
+    size_t cuts[MAX_CHUNKS + 1];
+    const uint8_t* raw;
+    uint8_t flags = fuzz_byte(&in);
+    size_t pattern_pos = fuzz_byte(&in) | (size_t)fuzz_byte(&in) << 8;
+    size_t quote_pos = fuzz_byte(&in) | (size_t)fuzz_byte(&in) << 8;
+    int ncuts = fuzz_byte(&in) % MAX_CHUNKS;
+    const char* value;
+    size_t value_len;
+    int found;
+
+    for (int i = 0; i < ncuts; i++) cuts[i] = fuzz_byte(&in) | (size_t)fuzz_byte(&in) << 8;
+    size_t len = fuzz_bytes(&in, MAX_BODY - 32, &raw);
+    memcpy(body, raw, len);
+    if (flags & 1) len = splice(body, len, pattern_pos, PATTERN);
+    if (flags & 2) len = splice(body, len, pattern_pos + 10 + quote_pos % 80, "\"");
+    body[len] = '\0';
+
+    found = web3_json_result(body, len, &value, &value_len) == 0;
+    if (found) {
+        FUZZ_CHECK(value >= body && value + value_len < body + len && value[value_len] == '"'
+                && memmem(body, len, PATTERN, strlen(PATTERN)) + strlen(PATTERN) == value,
+                "value at %td+%zu of %zu bytes", value - body, value_len, len);
+    }
+
+    // Without NUL bytes the result is the one strstr() finds
+    if (memchr(body, '\0', len) == NULL) {
+        size_t ref_len = 0;
+        const char* ref = ref_extract(body, &ref_len);
+        FUZZ_CHECK((ref != NULL) == found && (!found || (ref == value && ref_len == value_len)),
+                "web3_json_result %s, reference %s", found ? "found" : "not found",
+                ref ? "found" : "not found");
+    }
+
+    // Received in chunks, scanning stops as soon as the value is complete
+    // and extraction then works on what was received so far
+    size_t received = 0, result_pos = 0;
+    int complete = 0;
+    cuts[ncuts++] = len;
+    for (int i = 0; i < ncuts && !complete; i++) {
+        size_t end = received + (len - received ? cuts[i] % (len - received + 1) : 0);
+        if (i == ncuts - 1) end = len;
+        complete = web3_json_result_scan(body, received, end, &result_pos);
+        received = end;
+    }
+    FUZZ_CHECK(complete == found, "chunked scan %s, whole body %s",
+            complete ? "complete" : "incomplete", found ? "found" : "not found");
+    if (complete) {
+        const char* part;
+        size_t part_len;
+        FUZZ_CHECK(web3_json_result(body, received, &part, &part_len) == 0
+                && part == value && part_len == value_len && result_pos == (size_t)(value - body),
+                "result of the first %zu bytes differs", received);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Fuzz target: keccak256() against known vectors and ref_keccak256()
+ */
+
+#include <string.h>
+
+#include "fuzz.h"
+#include "ref_keccak.h"
+#include "web3_keccak.h"
+
+// Published Keccak-256 values, function selectors, and inputs of the
+// lengths around the 136 byte rate, bytes 0, 1, 2, ...
+static const struct {
+    const char* text;
+    int len;        // -1: strlen(text); otherwise a counting pattern
+    const char* hash;
+} vectors[] = {
+    {"", -1, "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"},
+    {"abc", -1, "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45"},
+    {"The quick brown fox jumps over the lazy dog", -1,
+        "4d741b6f1eb29cb2a9b9911c82f56fa8d73b04959d3d9d222895df6c0b28aa15"},
+    {"transfer(address,uint256)", -1, "a9059cbb"},
+    {"balanceOf(address)", -1, "70a08231"},
+    {NULL, 1, "bc36789e7a1e281436464229828f817d6612f7b477d66591ff96a9e064bcc98a"},
+    {NULL, 135, "cbdfd9dee5faad3818d6b06f95a219fd290b0e1706f6a82e5a595b9ce9faca62"},
+    {NULL, 136, "7ce759f1ab7f9ce437719970c26b0a66ff11fe3e38e17df89cf5d29c7d7f807e"},
+    {NULL, 137, "ac73d4fae68b8453f764007c1a20ce95994187861f0c3227a3a8e99a73a3b1db"},
+    {NULL, 271, "7c974895b2a88303ff2dc6b58f438ceb0b298cac91099ac0539cc0f477506191"},
+    {NULL, 272, "fdf2ec49e749960d3c8521a0219af8d03e30e2b3bf19bd16150ee0eaf133d66e"},
+    {NULL, 273, "4f707289a9c3ccd0c4a51f2f17339f5dd171d371c04ff7783b735b5b22682eaf"},
+    {NULL, 1000, "aca79e4146e30eb1c733f6d6060d72471c36ea4e01ebf45d7f4916249c2bbd82"},
+};
+
+static void to_hex(const uint8_t* in, size_t len, char* out) {
+    for (size_t i = 0; i < len; i++) sprintf(out + 2 * i, "%02x", in[i]);
+}
+
+int LLVMFuzzerInitialize(int* argc, char*** argv) {
+    uint8_t msg[1000], hash[32], ref[32];
+    char hex[65];
+
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        size_t len;
+        if (vectors[v].text) {
+            len = strlen(vectors[v].text);
+            memcpy(msg, vectors[v].text, len);
+        } else {
+            len = vectors[v].len;
+            for (size_t i = 0; i < len; i++) msg[i] = (uint8_t)i;
+        }
+        keccak256(msg, len, hash);
+        ref_keccak256(msg, len, ref);
+        to_hex(hash, 32, hex);
+        FUZZ_CHECK(strncmp(hex, vectors[v].hash, strlen(vectors[v].hash)) == 0,
+                "vector %zu (%zu bytes): got %s want %s", v, len, hex, vectors[v].hash);
+        to_hex(ref, 32, hex);
+        FUZZ_CHECK(strncmp(hex, vectors[v].hash, strlen(vectors[v].hash)) == 0,
+                "reference, vector %zu (%zu bytes): got %s want %s", v, len, hex,
+                vectors[v].hash);
+    }
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    uint8_t hash[32], ref[32];
+    char a[65], b[65];
+
+    keccak256(data, size, hash);
+    ref_keccak256(data, size, ref);
+    if (memcmp(hash, ref, 32) != 0) {
+        to_hex(hash, 32, a);
+        to_hex(ref, 32, b);
+        FUZZ_CHECK(0, "%zu bytes: keccak256 %s, reference %s", size, a, b);
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Reference ABI encoder for differential testing
+ *
+ * Builds the binary call data in the order the Solidity ABI
+ * specification describes (selector, head words, tails) with big
+ * integers as byte arrays, and only converts to hex at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ref_abi.h"
+#include "ref_keccak.h"
+
+typedef struct buf {
+    uint8_t* p;
+    size_t len;
+    size_t size;
+} buf_t;
+
+static int put(buf_t* b, const uint8_t* data, size_t len) {
+    if (b->len + len > b->size) {
+        size_t size = b->size ? b->size * 2 : 1024;
+        while (size < b->len + len) size *= 2;
+        uint8_t* p = realloc(b->p, size);
+        if (!p) return -1;
+        b->p = p;
+        b->size = size;
+    }
+    memcpy(b->p + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+static int put_number(buf_t* b, uint64_t v) {
+    uint8_t word[32] = {0};
+    for (int i = 0; i < 8; i++) word[31 - i] = (uint8_t)(v >> (8 * i));
+    return put(b, word, 32);
+}
+
+static int hexval(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Big endian 256 bit word of a decimal (at most 2^64 - 1) or 0x hex
+// number; -1 if malformed or wider than 'bits'
+static int number_word(const uint8_t* s, size_t len, int bits, uint8_t word[32]) {
+    memset(word, 0, 32);
+    if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        int nibble = 0;
+        for (size_t i = len; i > 2; i--, nibble++) {
+            int v = hexval(s[i - 1]);
+            if (v < 0) return -1;
+            if (v == 0) continue;
+            if (nibble >= 64 || nibble * 4 + (v >= 8 ? 4 : v >= 4 ? 3 : v >= 2 ? 2 : 1) > bits) {
+                return -1;
+            }
+            word[31 - nibble / 2] |= (uint8_t)(v << (4 * (nibble % 2)));
+        }
+        return 0;
+    }
+
+    uint64_t n = 0;
+    if (len == 0) return -1;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return -1;
+        if (n > (UINT64_MAX - (s[i] - '0')) / 10) return -1;
+        n = n * 10 + (s[i] - '0');
+    }
+    if (bits < 64 && n >> bits) return -1;
+    for (int i = 0; i < 8; i++) word[31 - i] = (uint8_t)(n >> (8 * i));
+    return 0;
+}
+
+static int is_dynamic(const char* type) {
+    return strcmp(type, "string") == 0 || strcmp(type, "bytes") == 0;
+}
+
+static int static_word(const ref_abi_value_t* a, uint8_t word[32]) {
+    int n;
+
+    memset(word, 0, 32);
+    if (strncmp(a->type, "bytes", 5) == 0 && sscanf(a->type + 5, "%d", &n) == 1) {
+        if (a->len > (size_t)n) return -1;
+        memcpy(word, a->data, a->len);
+        return 0;
+    }
+    if (strncmp(a->type, "uint", 4) == 0 && sscanf(a->type + 4, "%d", &n) == 1) {
+        return number_word(a->data, a->len, n, word);
+    }
+    if (strcmp(a->type, "address") == 0) {
+        if (a->len != 42) return -1;
+        return number_word(a->data, a->len, 160, word);
+    }
+    if (strcmp(a->type, "bool") == 0) {
+        const char* s = (const char*)a->data;
+        if ((a->len == 1 && s[0] == '1') || (a->len == 4 && strncasecmp(s, "true", 4) == 0)) {
+            word[31] = 1;
+            return 0;
+        }
+        if ((a->len == 1 && s[0] == '0') || (a->len == 5 && strncasecmp(s, "false", 5) == 0)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int ref_abi_encode(const char* name, const ref_abi_value_t* args, int nargs,
+        char* out, size_t out_size) {
+    char signature[1024];
+    uint8_t hash[32], word[32];
+    buf_t head = {0}, tail = {0};
+    size_t sig_len;
+    int ret = -1;
+
+    sig_len = snprintf(signature, sizeof(signature), "%s(", name);
+    for (int i = 0; i < nargs; i++) {
+        sig_len += snprintf(signature + sig_len, sizeof(signature) - sig_len, "%s%s",
+                i ? "," : "", args[i].type);
+    }
+    sig_len += snprintf(signature + sig_len, sizeof(signature) - sig_len, ")");
+    ref_keccak256((const uint8_t*)signature, sig_len, hash);
+    if (put(&head, hash, 4) < 0) goto done;
+
+    for (int i = 0; i < nargs; i++) {
+        if (!is_dynamic(args[i].type)) {
+            if (static_word(&args[i], word) < 0 || put(&head, word, 32) < 0) goto done;
+            continue;
+        }
+        static const uint8_t zeros[32] = {0};
+        if (put_number(&head, 32 * (uint64_t)nargs + tail.len) < 0
+                || put_number(&tail, args[i].len) < 0
+                || put(&tail, args[i].data, args[i].len) < 0
+                || put(&tail, zeros, (32 - args[i].len % 32) % 32) < 0) {
+            goto done;
+        }
+    }
+
+    if (2 * (head.len + tail.len) + 1 > out_size) goto done;
+    for (size_t i = 0; i < head.len; i++) sprintf(out + 2 * i, "%02x", head.p[i]);
+    for (size_t i = 0; i < tail.len; i++) sprintf(out + 2 * (head.len + i), "%02x", tail.p[i]);
+    ret = (int)(2 * (head.len + tail.len));
+
+done:
+    free(head.p);
+    free(tail.p);
+    return ret;
+}
+
+// Word at hex position 'pos' as an offset or length, at most 'max'
+static long word_uint(const char* hex, int len, long pos, long max) {
+    long v = 0;
+    int d;
+
+    if (pos < 0 || pos + 64 > len) return -1;
+    for (int i = 0; i < 64; i++) {
+        d = hexval((uint8_t)hex[pos + i]);
+        if (d < 0 || (i < 56 && d != 0)) return -1;
+        v = v * 16 + d;
+    }
+    return v <= max ? v : -1;
+}
+
+int ref_abi_decode_dynamic(const char* hex, int len, int index,
+        const char** data, int* size) {
+    long offset, n;
+
+    if (index < 0) return -1;
+    offset = word_uint(hex, len, 64L * index, len / 2);
+    if (offset < 0) return -1;
+    n = word_uint(hex, len, 2 * offset, len / 2);
+    if (n < 0 || 2 * offset + 64 + 2 * n > len) return -1;
+
+    *data = hex + 2 * offset + 64;
+    *size = (int)n;
+    return 0;
+}
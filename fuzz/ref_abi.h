@@ -0,0 +1,31 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Reference ABI encoder for differential testing
+ */
+
+#ifndef _REF_ABI_H_
+#define _REF_ABI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ref_abi_value {
+    const char* type;       // canonical type name, e.g. "uint64"
+    const uint8_t* data;
+    size_t len;
+} ref_abi_value_t;
+
+// Hex call data (no "0x") of 'name' with these arguments, written to
+// 'out'; returns its length, -1 if a value does not fit its type or
+// 'out_size' is too small. The accepted values are the ones documented
+// for web3_abi_encode()
+int ref_abi_encode(const char* name, const ref_abi_value_t* args, int nargs,
+        char* out, size_t out_size);
+
+// Locate dynamic string/bytes argument 'index' in hex call data 'hex'
+// (without selector): sets 'data' to its hex chars and 'size' to its
+// length in bytes; -1 if the offset or length words are invalid
+int ref_abi_decode_dynamic(const char* hex, int len, int index,
+        const char** data, int* size);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Reference Keccak-256 for differential testing
+ *
+ * Written from the Keccak reference: the state is indexed A[x][y] as in
+ * the specification, lanes are loaded little endian byte by byte and
+ * every step of the round is its own loop. Slow and obvious on purpose.
+ */
+
+#include <string.h>
+
+#include "ref_keccak.h"
+
+static const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+// Rotation offsets r[x][y]
+static const int R[5][5] = {
+    {0, 36, 3, 41, 18},
+    {1, 44, 10, 45, 2},
+    {62, 6, 43, 15, 61},
+    {28, 55, 25, 21, 56},
+    {27, 20, 39, 8, 14}
+};
+
+static uint64_t rot(uint64_t v, int n) {
+    return n ? (v << n) | (v >> (64 - n)) : v;
+}
+
+static void keccak_f(uint64_t A[5][5]) {
+    uint64_t B[5][5], C[5], D[5];
+
+    for (int round = 0; round < 24; round++) {
+        for (int x = 0; x < 5; x++) {
+            C[x] = A[x][0] ^ A[x][1] ^ A[x][2] ^ A[x][3] ^ A[x][4];
+        }
+        for (int x = 0; x < 5; x++) {
+            D[x] = C[(x + 4) % 5] ^ rot(C[(x + 1) % 5], 1);
+        }
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) A[x][y] ^= D[x];
+        }
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) B[y][(2 * x + 3 * y) % 5] = rot(A[x][y], R[x][y]);
+        }
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) {
+                A[x][y] = B[x][y] ^ (~B[(x + 1) % 5][y] & B[(x + 2) % 5][y]);
+            }
+        }
+        A[0][0] ^= RC[round];
+    }
+}
+
+void ref_keccak256(const uint8_t* in, size_t len, uint8_t out[32]) {
+    const size_t rate = 136;
+    uint64_t A[5][5];
+    uint8_t block[136];
+    size_t done = 0;
+    int last = 0;
+
+    memset(A, 0, sizeof(A));
+    while (!last) {
+        size_t n = len - done < rate ? len - done : rate;
+        memset(block, 0, rate);
+        memcpy(block, in + done, n);
+        done += n;
+        if (n < rate) {
+            // pad10*1 with the original Keccak domain bit
+            block[n] ^= 0x01;
+            block[rate - 1] ^= 0x80;
+            last = 1;
+        }
+        for (size_t i = 0; i < rate / 8; i++) {
+            uint64_t lane = 0;
+            for (int b = 7; b >= 0; b--) lane = (lane << 8) | block[8 * i + b];
+            A[i % 5][i / 5] ^= lane;
+        }
+        keccak_f(A);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 8; b++) out[8 * i + b] = (uint8_t)(A[i % 5][i / 5] >> (8 * b));
+    }
+}
@@ -0,0 +1,14 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Reference Keccak-256 for differential testing
+ */
+
+#ifndef _REF_KECCAK_H_
+#define _REF_KECCAK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+void ref_keccak256(const uint8_t* in, size_t len, uint8_t out[32]);
+
+#endif
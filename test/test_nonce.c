@@ -0,0 +1,137 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Tests of the replay protection of qop=auth credentials
+ *
+ * Checks the nonce freshness of web3_nonce.c and the nonce-count records
+ * of web3_cache.c the way ha1_check() uses them: a full set answers stale
+ * instead of evicting a live nonce, and a nonce is refused once expired
+ * even after its record is gone.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "web3_cache.h"
+#include "web3_nonce.h"
+
+static int failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond); \
+            failed++; \
+        } \
+    } while (0)
+
+// Nonce in the auth module's format: base64 of expiry, creation time and
+// an MD5 (left zero, it is not checked)
+static void make_nonce(char* out, unsigned int expires, unsigned int since) {
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint8_t bin[24] = {0};
+    int n = 0;
+
+    for (int i = 0; i < 4; i++) {
+        bin[i] = (uint8_t)(expires >> (24 - 8 * i));
+        bin[4 + i] = (uint8_t)(since >> (24 - 8 * i));
+    }
+    for (int i = 0; i < (int)sizeof(bin); i += 3) {
+        uint32_t v = (uint32_t)bin[i] << 16 | (uint32_t)bin[i + 1] << 8
+            | bin[i + 2];
+        out[n++] = b64[v >> 18];
+        out[n++] = b64[(v >> 12) & 63];
+        out[n++] = b64[(v >> 6) & 63];
+        out[n++] = b64[v & 63];
+    }
+    out[n] = '\0';
+}
+
+static int nc_check(web3_cache_t* cache, char* nonce, unsigned int nc,
+        unsigned int now, unsigned int expires) {
+    str key = {nonce, (int)strlen(nonce)};
+
+    return web3_cache_nc_check(cache, &key, nc, now, expires);
+}
+
+// One set of four ways: the fifth live nonce gets no record and is answered
+// stale, and is accepted once the records it would evict have expired
+static void test_full_set(void) {
+    web3_cache_t* cache = web3_cache_new(4, sizeof(unsigned int));
+    unsigned int t0 = 1000000;
+    char nonce[5][40];
+
+    CHECK(cache != NULL);
+    for (int i = 0; i < 5; i++) make_nonce(nonce[i], t0 + 300, t0 + i);
+
+    for (int i = 0; i < 4; i++) {
+        CHECK(nc_check(cache, nonce[i], 1, t0, t0 + 300) == 1);
+    }
+    CHECK(nc_check(cache, nonce[4], 1, t0, t0 + 300) == -1);
+
+    // The tracked nonces keep working and keep refusing replays
+    CHECK(nc_check(cache, nonce[0], 2, t0 + 1, t0 + 300) == 1);
+    CHECK(nc_check(cache, nonce[0], 2, t0 + 1, t0 + 300) == 0);
+
+    // The client retries with a new nonce after the others expired
+    make_nonce(nonce[4], t0 + 601, t0 + 301);
+    CHECK(nc_check(cache, nonce[4], 1, t0 + 301, t0 + 601) == 1);
+    CHECK(nc_check(cache, nonce[4], 1, t0 + 302, t0 + 601) == 0);
+
+    web3_cache_destroy(cache);
+}
+
+// A replay is refused by its nonce-count while the nonce lives and by the
+// nonce's expiry after that
+static void test_replay_after_expiry(void) {
+    web3_cache_t* cache = web3_cache_new(4, sizeof(unsigned int));
+    unsigned int t0 = 1000000, expires = 0;
+    char nonce[40];
+
+    make_nonce(nonce, t0 + 300, t0);
+
+    CHECK(web3_nonce_check(nonce, strlen(nonce), t0, 300, &expires) == 1);
+    CHECK(expires == t0 + 300);
+    CHECK(nc_check(cache, nonce, 1, t0, expires) == 1);
+
+    CHECK(web3_nonce_check(nonce, strlen(nonce), t0 + 10, 300, &expires) == 1);
+    CHECK(nc_check(cache, nonce, 1, t0 + 10, expires) == 0);
+
+    // The record is gone with the nonce: only the freshness check stops it
+    CHECK(web3_nonce_check(nonce, strlen(nonce), t0 + 301, 300, &expires) == 0);
+    CHECK(nc_check(cache, nonce, 1, t0 + 301, expires) == 1);
+
+    web3_cache_destroy(cache);
+}
+
+static void test_nonce_format(void) {
+    unsigned int t0 = 1000000, expires = 0;
+    char nonce[64];
+
+    // Valid for longer than nonce_expire allows
+    make_nonce(nonce, t0 + 3600, t0);
+    CHECK(web3_nonce_check(nonce, strlen(nonce), t0, 300, &expires) == 0);
+
+    // Padding is accepted, other characters and short blocks are not
+    make_nonce(nonce, t0 + 300, t0);
+    strcat(nonce, "==");
+    CHECK(web3_nonce_check(nonce, strlen(nonce), t0, 300, &expires) == 1);
+    CHECK(web3_nonce_check("abcdef0123", 10, t0, 300, &expires) == -1);
+    CHECK(web3_nonce_check("not a nonce!", 12, t0, 300, &expires) == -1);
+    memset(nonce, 'A', sizeof(nonce));
+    CHECK(web3_nonce_check(nonce, sizeof(nonce), t0, 300, &expires) == -1);
+}
+
+int main(void) {
+    test_full_set();
+    test_replay_after_expiry();
+    test_nonce_format();
+
+    if (failed) {
+        fprintf(stderr, "%d check(s) failed\n", failed);
+        return 1;
+    }
+    printf("test_nonce: OK\n");
+    return 0;
+}
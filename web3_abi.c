@@ -0,0 +1,275 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Table driven Solidity ABI encoding of contract calls
+ *
+ * Layout: selector, one head word per argument (the value for static
+ * types, the tail offset for dynamic ones), then for each dynamic
+ * argument its length word and its data padded to 32 bytes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "../../core/dprint.h"
+
+#include "web3_abi.h"
+#include "web3_keccak.h"
+#include "web3_hex.h"
+
+static inline int abi_is_dynamic(const web3_abi_arg_t* arg) {
+    return arg->type == WEB3_ABI_STRING || arg->type == WEB3_ABI_BYTES;
+}
+
+// Parse a positive decimal number of at most 3 digits
+static int parse_small_num(const char* s, int len) {
+    int n = 0;
+    if (len <= 0 || len > 3) return -1;
+    for (int i = 0; i < len; i++) {
+        if (!isdigit((unsigned char)s[i])) return -1;
+        n = n * 10 + (s[i] - '0');
+    }
+    return n;
+}
+
+// Parse one type name, appending its canonical form to 'canon'
+static int parse_type(const char* s, int len, web3_abi_arg_t* arg, char* canon,
+        int* canon_len) {
+    char tmp[16];
+    int n;
+
+    if (len == 6 && memcmp(s, "string", 6) == 0) {
+        arg->type = WEB3_ABI_STRING;
+        arg->size = 0;
+        n = snprintf(tmp, sizeof(tmp), "string");
+    } else if (len == 5 && memcmp(s, "bytes", 5) == 0) {
+        arg->type = WEB3_ABI_BYTES;
+        arg->size = 0;
+        n = snprintf(tmp, sizeof(tmp), "bytes");
+    } else if (len > 5 && memcmp(s, "bytes", 5) == 0) {
+        arg->type = WEB3_ABI_BYTES_N;
+        arg->size = parse_small_num(s + 5, len - 5);
+        if (arg->size < 1 || arg->size > 32) return -1;
+        n = snprintf(tmp, sizeof(tmp), "bytes%d", arg->size);
+    } else if (len >= 4 && memcmp(s, "uint", 4) == 0) {
+        arg->type = WEB3_ABI_UINT;
+        arg->size = (len == 4) ? 256 : parse_small_num(s + 4, len - 4);
+        if (arg->size < 8 || arg->size > 256 || arg->size % 8) return -1;
+        n = snprintf(tmp, sizeof(tmp), "uint%d", arg->size);
+    } else if (len == 7 && memcmp(s, "address", 7) == 0) {
+        arg->type = WEB3_ABI_ADDRESS;
+        arg->size = 160;
+        n = snprintf(tmp, sizeof(tmp), "address");
+    } else if (len == 4 && memcmp(s, "bool", 4) == 0) {
+        arg->type = WEB3_ABI_BOOL;
+        arg->size = 8;
+        n = snprintf(tmp, sizeof(tmp), "bool");
+    } else {
+        return -1;
+    }
+
+    if (*canon_len + n + 2 >= WEB3_ABI_MAX_SIGNATURE) return -1;
+    memcpy(canon + *canon_len, tmp, n);
+    *canon_len += n;
+    return 0;
+}
+
+int web3_abi_parse(const char* signature, web3_abi_method_t* m) {
+    const char* p = signature;
+    const char* start;
+    int canon_len = 0;
+    uint8_t hash[32];
+
+    memset(m, 0, sizeof(*m));
+
+    // method name
+    while (*p == ' ') p++;
+    start = p;
+    while (*p && (isalnum((unsigned char)*p) || *p == '_')) p++;
+    if (p == start || *p != '(' || p - start + 2 >= WEB3_ABI_MAX_SIGNATURE) {
+        LM_ERR("Invalid method signature: %s\n", signature);
+        return -1;
+    }
+    memcpy(m->signature, start, p - start + 1);
+    canon_len = p - start + 1;
+    p++;
+
+    // argument types, separated by commas, spaces ignored
+    while (*p == ' ') p++;
+    while (*p && *p != ')') {
+        if (m->nargs == WEB3_ABI_MAX_ARGS) {
+            LM_ERR("Too many arguments in %s\n", signature);
+            return -1;
+        }
+        start = p;
+        while (isalnum((unsigned char)*p)) p++;
+        if (m->nargs > 0) m->signature[canon_len++] = ',';
+        if (parse_type(start, p - start, &m->args[m->nargs], m->signature,
+                &canon_len) < 0) {
+            LM_ERR("Unsupported type '%.*s' in %s\n", (int)(p - start), start,
+                    signature);
+            return -1;
+        }
+        if (abi_is_dynamic(&m->args[m->nargs])) m->ndynamic++;
+        m->nargs++;
+        while (*p == ' ') p++;
+        if (*p == ',') {
+            p++;
+            while (*p == ' ') p++;
+            // a trailing comma would silently change the selector
+            if (*p == ')') {
+                LM_ERR("Missing argument type after ',' in %s\n", signature);
+                return -1;
+            }
+        } else if (*p != ')') {
+            break;
+        }
+    }
+    if (*p != ')') {
+        LM_ERR("Invalid method signature: %s\n", signature);
+        return -1;
+    }
+    m->signature[canon_len++] = ')';
+    m->signature[canon_len] = '\0';
+
+    keccak256((const uint8_t*)m->signature, canon_len, hash);
+    web3_hex_encode(hash, 4, m->selector);
+    m->head_len = 8 + WEB3_ABI_WORD_HEX * m->nargs;
+
+    return 0;
+}
+
+// Padded size in bytes of the data part of a dynamic value
+static inline int padded_size(int len) {
+    return (len + 31) & ~31;
+}
+
+int web3_abi_encoded_len(const web3_abi_method_t* m, const str* values) {
+    int len = m->head_len;
+
+    if (m->ndynamic == 0) return len;
+
+    for (int i = 0; i < m->nargs; i++) {
+        if (abi_is_dynamic(&m->args[i])) {
+            len += WEB3_ABI_WORD_HEX + 2 * padded_size(values[i].len);
+        }
+    }
+    return len;
+}
+
+// Write an unsigned integer as a 64 hex char big endian word
+static void put_uint(char* p, uint64_t v) {
+    uint8_t be[8];
+    for (int i = 7; i >= 0; i--) {
+        be[i] = (uint8_t)v;
+        v >>= 8;
+    }
+    memset(p, '0', WEB3_ABI_WORD_HEX - 16);
+    web3_hex_encode(be, 8, p + WEB3_ABI_WORD_HEX - 16);
+}
+
+// Write a uintN value given in decimal (up to 64 bits) or 0x hex
+static int put_uint_value(char* p, const str* v, int bits) {
+    uint64_t n = 0;
+    int digits = bits / 4;
+
+    if (v->len > 2 && v->s[0] == '0' && (v->s[1] == 'x' || v->s[1] == 'X')) {
+        const char* h = v->s + 2;
+        int hlen = v->len - 2;
+        // leading zeros do not count against the width
+        while (hlen > 0 && *h == '0') {
+            h++;
+            hlen--;
+        }
+        if (hlen > digits) return -1;
+        memset(p, '0', WEB3_ABI_WORD_HEX - hlen);
+        for (int i = 0; i < hlen; i++) {
+            char c = h[i];
+            if (!isxdigit((unsigned char)c)) return -1;
+            p[WEB3_ABI_WORD_HEX - hlen + i] = (char)tolower((unsigned char)c);
+        }
+        return 0;
+    }
+
+    if (v->len == 0) return -1;
+    for (int i = 0; i < v->len; i++) {
+        uint64_t d = (uint64_t)(v->s[i] - '0');
+        if (!isdigit((unsigned char)v->s[i]) || n > (UINT64_MAX - d) / 10) return -1;
+        n = n * 10 + d;
+    }
+    if (bits < 64 && (n >> bits) != 0) return -1;
+    put_uint(p, n);
+    return 0;
+}
+
+// Write one static argument word
+static int put_static(char* p, const web3_abi_arg_t* arg, const str* v) {
+    switch (arg->type) {
+        case WEB3_ABI_BYTES_N:
+            if (v->len > arg->size) return -1;
+            web3_hex_encode((const uint8_t*)v->s, v->len, p);
+            memset(p + 2 * v->len, '0', WEB3_ABI_WORD_HEX - 2 * v->len);
+            return 0;
+        case WEB3_ABI_UINT:
+            return put_uint_value(p, v, arg->size);
+        case WEB3_ABI_ADDRESS:
+            if (v->len != 42 || v->s[0] != '0' || (v->s[1] != 'x' && v->s[1] != 'X')) {
+                return -1;
+            }
+            return put_uint_value(p, v, 160);
+        case WEB3_ABI_BOOL:
+            if ((v->len == 1 && v->s[0] == '1')
+                    || (v->len == 4 && strncasecmp(v->s, "true", 4) == 0)) {
+                put_uint(p, 1);
+            } else if ((v->len == 1 && v->s[0] == '0')
+                    || (v->len == 5 && strncasecmp(v->s, "false", 5) == 0)) {
+                put_uint(p, 0);
+            } else {
+                return -1;
+            }
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int web3_abi_encode(const web3_abi_method_t* m, const str* values, char* out) {
+    char* head = out + 8;
+    char* tail = out + m->head_len;
+    uint64_t offset = 32 * (uint64_t)m->nargs;
+
+    memcpy(out, m->selector, 8);
+
+    for (int i = 0; i < m->nargs; i++, head += WEB3_ABI_WORD_HEX) {
+        const web3_abi_arg_t* arg = &m->args[i];
+        const str* v = &values[i];
+
+        if (!abi_is_dynamic(arg)) {
+            if (put_static(head, arg, v) < 0) {
+                LM_ERR("Value '%.*s' does not fit argument %d of %s\n",
+                        v->len, v->s, i, m->signature);
+                return -1;
+            }
+            continue;
+        }
+
+        int padded = padded_size(v->len);
+        put_uint(head, offset);
+        put_uint(tail, (uint64_t)v->len);
+        tail += WEB3_ABI_WORD_HEX;
+        web3_hex_encode((const uint8_t*)v->s, v->len, tail);
+        memset(tail + 2 * v->len, '0', 2 * (padded - v->len));
+        tail += 2 * padded;
+        offset += 32 + padded;
+    }
+
+    return tail - out;
+}
+
+int web3_abi_decode_word(const char* hex, int len, int index, uint8_t word[32]) {
+    int pos = index * WEB3_ABI_WORD_HEX;
+
+    if (index < 0 || pos + WEB3_ABI_WORD_HEX > len) return -1;
+    return web3_hex_decode(hex + pos, WEB3_ABI_WORD_HEX, word);
+}
@@ -0,0 +1,59 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Table driven Solidity ABI encoding of contract calls
+ *
+ * A method signature such as "getDigestHash(string,string,string,string,string)"
+ * is parsed once at startup into a web3_abi_method_t holding the selector
+ * and the argument layout. Per request the call data is then written in a
+ * single pass into a buffer of precomputed size.
+ */
+
+#ifndef _WEB3_ABI_H_
+#define _WEB3_ABI_H_
+
+#include <stdint.h>
+
+#include "../../core/str.h"
+
+#define WEB3_ABI_MAX_ARGS 16
+#define WEB3_ABI_MAX_SIGNATURE 256
+#define WEB3_ABI_WORD_HEX 64
+
+typedef enum web3_abi_type {
+    WEB3_ABI_STRING = 0,    // dynamic, value is the raw string
+    WEB3_ABI_BYTES,         // dynamic, value is the raw bytes
+    WEB3_ABI_BYTES_N,       // static bytes1..bytes32, value left aligned
+    WEB3_ABI_UINT,          // static uint8..uint256, value decimal or 0x hex
+    WEB3_ABI_ADDRESS,       // static, value 0x + 40 hex chars
+    WEB3_ABI_BOOL           // static, value "0"/"1"/"true"/"false"
+} web3_abi_type_t;
+
+typedef struct web3_abi_arg {
+    web3_abi_type_t type;
+    int size;               // N of bytesN, bits of uintN
+} web3_abi_arg_t;
+
+typedef struct web3_abi_method {
+    char signature[WEB3_ABI_MAX_SIGNATURE];  // canonical form
+    char selector[8];       // hex of the first 4 bytes of keccak256(signature)
+    int nargs;
+    int ndynamic;           // number of dynamic arguments
+    int head_len;           // hex chars of selector + head words
+    web3_abi_arg_t args[WEB3_ABI_MAX_ARGS];
+} web3_abi_method_t;
+
+// Parse a method signature; returns 0 on success, -1 on syntax error or
+// unsupported type
+int web3_abi_parse(const char* signature, web3_abi_method_t* m);
+
+// Hex length of the call data for these argument values (no "0x", no NUL)
+int web3_abi_encoded_len(const web3_abi_method_t* m, const str* values);
+
+// Write the call data to 'out' (web3_abi_encoded_len() chars); returns the
+// number of chars written or -1 if a value does not fit its type
+int web3_abi_encode(const web3_abi_method_t* m, const str* values, char* out);
+
+// Decode static word 'index' of a hex encoded return value (without "0x")
+int web3_abi_decode_word(const char* hex, int len, int index, uint8_t word[32]);
+
+#endif
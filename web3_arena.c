@@ -0,0 +1,142 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Per-process bump allocator for the buffers of one authentication
+ *
+ * The arena is a list of pkg blocks, newest first. Allocations bump the
+ * 'used' mark of the newest block; one that does not fit opens a new
+ * block of at least twice its size, so a response growing chunk by chunk
+ * is copied a logarithmic number of times.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+
+#include "web3_arena.h"
+
+#define ARENA_ALIGN 8
+
+struct web3_arena_block {
+    web3_arena_block_t* next;   // older block
+    size_t size;
+    size_t used;
+    char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+static inline size_t arena_align(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static web3_arena_block_t* arena_block_new(size_t size) {
+    web3_arena_block_t* b = pkg_malloc(sizeof(web3_arena_block_t) + size);
+
+    if (!b) {
+        PKG_MEM_ERROR;
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+void web3_arena_init(web3_arena_t* a, size_t size) {
+    memset(a, 0, sizeof(*a));
+    a->size = arena_align(size ? size : ARENA_ALIGN);
+}
+
+void* web3_arena_alloc(web3_arena_t* a, size_t size) {
+    web3_arena_block_t* b = a->head;
+    void* p;
+
+    size = arena_align(size ? size : 1);
+    if (!b) {
+        b = arena_block_new(a->size > size ? a->size : size);
+        if (!b) return NULL;
+        a->head = a->first = b;
+    } else if (b->size - b->used < size) {
+        size_t bsize = 2 * size > a->size ? 2 * size : a->size;
+        b = arena_block_new(bsize);
+        if (!b) return NULL;
+        b->next = a->head;
+        a->head = b;
+    }
+
+    p = b->data + b->used;
+    b->used += size;
+    a->total += size;
+    a->last = p;
+    return p;
+}
+
+void* web3_arena_realloc(web3_arena_t* a, void* p, size_t old_size, size_t size) {
+    web3_arena_block_t* b = a->head;
+    void* n;
+
+    if (!p) return web3_arena_alloc(a, size);
+
+    old_size = arena_align(old_size ? old_size : 1);
+    size = arena_align(size ? size : 1);
+    if (size <= old_size) return p;
+
+    // The latest allocation ends at the block's mark: just move the mark
+    if (p == a->last && b && b->size - b->used >= size - old_size) {
+        b->used += size - old_size;
+        a->total += size - old_size;
+        return p;
+    }
+
+    n = web3_arena_alloc(a, size);
+    if (n) memcpy(n, p, old_size);
+    return n;
+}
+
+void web3_arena_reset(web3_arena_t* a) {
+    web3_arena_block_t* b = a->head;
+    web3_arena_block_t* next;
+
+    if (!b) return;
+    if (a->total > a->peak) a->peak = a->total;
+
+    // Drop the blocks opened since the first one
+    while (b != a->first) {
+        next = b->next;
+        pkg_free(b);
+        b = next;
+    }
+
+    // Enlarge the first block when a check needed more than it holds, at
+    // least doubling it so slowly growing checks do not realloc each time
+    if (a->total > b->size && a->total <= WEB3_ARENA_KEEP_MAX) {
+        size_t size = 2 * b->size;
+        if (size < a->total) size = a->total;
+        if (size > WEB3_ARENA_KEEP_MAX) size = WEB3_ARENA_KEEP_MAX;
+        web3_arena_block_t* bigger = arena_block_new(arena_align(size));
+        if (bigger) {
+            LM_DBG("Arena grown from %zu to %zu bytes\n", b->size, bigger->size);
+            pkg_free(b);
+            b = bigger;
+            a->size = b->size;
+        }
+    }
+
+    b->used = 0;
+    a->head = a->first = b;
+    a->last = NULL;
+    a->total = 0;
+}
+
+void web3_arena_destroy(web3_arena_t* a) {
+    web3_arena_block_t* b = a->head;
+    web3_arena_block_t* next;
+
+    while (b) {
+        next = b->next;
+        pkg_free(b);
+        b = next;
+    }
+    a->head = a->first = NULL;
+    a->last = NULL;
+    a->total = 0;
+}
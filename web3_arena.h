@@ -0,0 +1,47 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Per-process bump allocator for the buffers of one authentication
+ *
+ * Everything a verification needs only until it returns (JSON-RPC
+ * payload, response body, result) is taken from the arena with a pointer
+ * increment and released at once by web3_arena_reset() when the check
+ * ends, so error paths have nothing to free.
+ */
+
+#ifndef _WEB3_ARENA_H_
+#define _WEB3_ARENA_H_
+
+#include <stddef.h>
+
+typedef struct web3_arena_block web3_arena_block_t;
+
+typedef struct web3_arena {
+    web3_arena_block_t* head;   // block allocations are taken from
+    web3_arena_block_t* first;  // kept across resets
+    void* last;                 // latest allocation, may grow in place
+    size_t size;                // size of the first block
+    size_t total;               // bytes taken since the last reset
+    size_t peak;                // most bytes taken between two resets
+} web3_arena_t;
+
+// Set up an arena whose first block holds 'size' bytes; the block is
+// allocated (from pkg memory) on first use
+void web3_arena_init(web3_arena_t* a, size_t size);
+
+// 'size' bytes, 8 byte aligned; NULL when out of pkg memory
+void* web3_arena_alloc(web3_arena_t* a, size_t size);
+
+// Grow 'p' (of 'old_size' bytes) to 'size' bytes: in place when it is the
+// latest allocation and its block has room, else by copying
+void* web3_arena_realloc(web3_arena_t* a, void* p, size_t old_size, size_t size);
+
+// Release everything allocated since the last reset. Extra blocks are
+// freed, and the first block is enlarged to what was needed (at least
+// doubled), up to WEB3_ARENA_KEEP_MAX, so the next check fits in one block
+void web3_arena_reset(web3_arena_t* a);
+
+void web3_arena_destroy(web3_arena_t* a);
+
+#define WEB3_ARENA_KEEP_MAX (256 * 1024)
+
+#endif
@@ -10,11 +10,15 @@
 #include <curl/curl.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <time.h>
+#include <stddef.h>
+#include <sys/time.h>
 
 #include "../../core/sr_module.h"
 #include "../../core/dprint.h"
 #include "../../core/error.h"
 #include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
 #include "../../core/parser/parse_to.h"
 #include "../../core/parser/parse_from.h"
 #include "../../core/parser/parse_uri.h"
@@ -24,6 +28,34 @@
 #include "../../core/data_lump.h"
 #include "../../core/ut.h"
 #include "../../core/mod_fix.h"
+#include "../../core/kstats_wrapper.h"
+#include "../../core/md5.h"
+#include "../../core/pvar.h"
+#include "../../core/timer_proc.h"
+#include "../../core/pt.h"
+#include "../../core/rpc.h"
+#include "../../core/rpc_lookup.h"
+#include "../../core/cfg/cfg_struct.h"
+#include "../../core/async_task.h"
+#include "../../core/route.h"
+#include "../../core/kemi.h"
+#include "../../core/tcp_conn.h"
+#include "../../modules/tm/tm_load.h"
+
+#include "web3_cache.h"
+#include "web3_sha2.h"
+#include "web3_hex.h"
+#include "web3_keccak.h"
+#include "web3_abi.h"
+#include "web3_dns.h"
+#include "web3_hist.h"
+#include "web3_metrics.h"
+#include "web3_trace.h"
+#include "web3_prof.h"
+#include "web3_json.h"
+#include "web3_arena.h"
+#include "web3_flow.h"
+#include "web3_nonce.h"
 
 MODULE_VERSION
 
@@ -31,33 +63,161 @@ MODULE_VERSION
 #define DEFAULT_CONTRACT_ADDRESS "0x1b55e67Ce5118559672Bf9EC0564AE3A46C41000"
 #define MAX_AUTH_HEADER_SIZE 2048
 #define MAX_FIELD_SIZE 256
+#define MD5_HEX_LEN 32
+#define MAX_DIGEST_HEX_LEN 64
+#define NC_LEN 8
+#define DEFAULT_DIGEST_METHOD "getDigestHash(string,string,string,string,string)"
+#define DEFAULT_DIGEST_ARGS \
+    "$web3auth(username);$web3auth(realm);$web3auth(method);$web3auth(uri);$web3auth(nonce)"
+#define DEFAULT_HA1_ARGS "$web3auth(username);$web3auth(realm)"
+#define DEFAULT_HA1_METHOD "getHA1(string,string)"
+#define DEFAULT_HA1_SHA256_METHOD "getHA1SHA256(string,string)"
+#define DEFAULT_HA1_SHA512_256_METHOD "getHA1SHA512_256(string,string)"
+#define HASHED_DIGEST_METHOD "getDigestHashById(bytes32,bytes32,string,string,string)"
+#define HASHED_HA1_METHOD "getHA1ById(bytes32,bytes32)"
+#define HASHED_HA1_SHA256_METHOD "getHA1SHA256ById(bytes32,bytes32)"
+#define HASHED_HA1_SHA512_256_METHOD "getHA1SHA512_256ById(bytes32,bytes32)"
+
+// Digest algorithms (RFC 7616); all but MD5 are verified locally from HA1
+typedef enum digest_alg {
+    DIGEST_MD5 = 0,
+    DIGEST_SHA256,
+    DIGEST_SHA512_256,
+    DIGEST_ALG_COUNT
+} digest_alg_t;
+
+typedef struct digest_alg_def {
+    str name;       // value of the algorithm parameter
+    int hex_len;    // length of the hex encoded hash
+} digest_alg_def_t;
+
+static const digest_alg_def_t digest_algs[DIGEST_ALG_COUNT] = {
+    {str_init("MD5"), MD5_HEX_LEN},
+    {str_init("SHA-256"), 2 * WEB3_SHA256_LEN},
+    {str_init("SHA-512-256"), 2 * WEB3_SHA512_256_LEN}
+};
+
+// Return codes of the authentication functions
+typedef enum web3_auth_result {
+    WEB3_AUTH_STALE_NONCE = -9,      // nonce expired or not trackable, challenge again
+    WEB3_AUTH_NONCE_REUSED = -8,     // nonce-count not increasing
+    WEB3_AUTH_URI_MISMATCH = -7,     // digest uri differs from Request-URI
+    WEB3_AUTH_UNSUPPORTED = -6,      // unknown algorithm or qop
+    WEB3_AUTH_MALFORMED = -5,        // bad response, username, uri, ...
+    WEB3_AUTH_NO_CREDENTIALS = -4,   // no (matching) credentials
+    WEB3_AUTH_USER_UNKNOWN = -3,     // user not found in contract
+    WEB3_AUTH_INVALID_PASSWORD = -2, // response mismatch
+    WEB3_AUTH_ERROR = -1,            // internal or RPC error
+    WEB3_AUTH_OK = 1,
+    WEB3_AUTH_PENDING = 2            // eth_call body ready for http_async_client
+} web3_auth_result_t;
 
 // Module parameters
 static char* rpc_url = DEFAULT_RPC_URL;
 static char* contract_address = DEFAULT_CONTRACT_ADDRESS;
+static char* digest_method = DEFAULT_DIGEST_METHOD;
+static char* digest_args = DEFAULT_DIGEST_ARGS;
+static int check_uri = 1;
+static int check_nonce = 1;
+static char* ha1_method = DEFAULT_HA1_METHOD;
+static char* ha1_sha256_method = DEFAULT_HA1_SHA256_METHOD;
+static char* ha1_sha512_256_method = DEFAULT_HA1_SHA512_256_METHOD;
+static char* ha1_args = DEFAULT_HA1_ARGS;
+static int hashed_ids = 0;
+static int rpc_compression = 1;
+static int rpc_max_response = 65536;
+static int dns_ttl = 300;
+static int rpc_connect_timeout = 2000;
+static int rpc_tls_timeout = 0;
+static int rpc_timeout = 10000;
+static int rpc_adaptive_timeout = 0;
+static int rpc_budget = 4000;
+static int metrics_port = 0;
+static char* metrics_address = "127.0.0.1";
+static char* trace_url = "";
+static char* trace_ratio = "0.01";
+static char* trace_service = "kamailio";
+static int profile = 0;
+static int ha1_mode = 0;
+static int ha1_cache_size = 4096;
+static int ha1_cache_ttl = 300;
+static int nc_cache_size = 4096;
+static int nonce_expire = 300;
+static int arena_size = 8192;
+static char* async_group = "";
+static int flow_ttl = 0;
+static int flow_max_requests = 100;
+static int flow_table_size = 4096;
 
-// Keccak-256 implementation constants
-#define KECCAK_ROUNDS 24
-
-static const uint64_t keccak_round_constants[KECCAK_ROUNDS] = {
-    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
-    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
-    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
-    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
-    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
-    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
-    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
-    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
-};
+// Per-process arena for the transient buffers of one verification, reset
+// when the check returns
+static web3_arena_t arena;
 
-static const int rho_offsets[24] = {
-    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
-};
+// RPC phases as measured by curl, with one latency histogram each (us)
+typedef enum rpc_phase {
+    RPC_PHASE_DNS = 0,      // name lookup
+    RPC_PHASE_CONNECT,      // TCP connect
+    RPC_PHASE_TLS,          // TLS handshake
+    RPC_PHASE_SERVER,       // request sent to first response byte
+    RPC_PHASE_TRANSFER,     // first to last response byte
+    RPC_PHASE_TOTAL,
+    RPC_PHASE_COUNT
+} rpc_phase_t;
 
-static const int pi_offsets[24] = {
-    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+static const char* rpc_phase_names[RPC_PHASE_COUNT] = {
+    "dns", "connect", "tls", "server", "transfer", "total"
 };
 
+// Per-process phase histograms and in-flight RPC flags, allocated in
+// child_init(PROC_INIT)
+static web3_hist_set_t* rpc_hist = NULL;
+static int* rpc_inflight = NULL;
+static int rpc_inflight_procs = 0;
+
+// Set when the RPC host is resolved by the DNS timer process
+static int dns_timer = 0;
+
+// Set when trace_url is; spans are exported every TRACE_EXPORT_INTERVAL us
+static int tracing = 0;
+static double trace_sample = 0;
+#define TRACE_EXPORT_INTERVAL 200000
+
+// Shared caches
+static web3_cache_t* ha1_cache = NULL;
+static web3_cache_t* nc_cache = NULL;
+
+// Identities bound to TCP/TLS/WS connections, when flow_ttl is set
+static web3_flow_table_t* flow_table = NULL;
+
+// A contract method, parsed once in mod_init. When all its arguments are
+// static the JSON-RPC payload has a fixed size and is built once as well;
+// each call then only overwrites the call data inside it.
+typedef struct {
+    web3_abi_method_t abi;
+    char* payload;
+    int data_offset;
+} contract_method_t;
+
+static contract_method_t digest_call;
+static contract_method_t ha1_calls[DIGEST_ALG_COUNT];
+
+// Statistics
+static stat_var* stat_malformed = 0;
+static stat_var* stat_unsupported = 0;
+static stat_var* stat_uri_mismatch = 0;
+static stat_var* stat_ha1_cache_hits = 0;
+static stat_var* stat_ha1_cache_misses = 0;
+static stat_var* stat_nc_replays = 0;
+static stat_var* stat_stale_nonces = 0;
+static stat_var* stat_flow_hits = 0;
+static stat_var* stat_rpc_timeouts = 0;
+static stat_var* stat_rpc_abandoned = 0;
+static stat_var* stat_auth_ok = 0;
+static stat_var* stat_auth_invalid_password = 0;
+static stat_var* stat_auth_user_unknown = 0;
+static stat_var* stat_auth_no_credentials = 0;
+static stat_var* stat_auth_errors = 0;
+
 // Structure to hold SIP digest auth components
 typedef struct {
     str username;
@@ -66,446 +226,1937 @@ typedef struct {
     str nonce;
     str response;
     str method;
+    str algorithm;
+    str qop;
+    str cnonce;
+    str nc;
+    digest_alg_t alg;
+    uint8_t response_bin[MAX_DIGEST_HEX_LEN / 2];  // decoded response
+    unsigned int nonce_expires;     // expiry of the nonce when checked, else 0
 } sip_auth_t;
 
+// Credential fields readable as $web3auth(name)
+static const struct {
+    str name;
+    size_t offset;
+} cred_fields[] = {
+    {str_init("username"), offsetof(sip_auth_t, username)},
+    {str_init("realm"), offsetof(sip_auth_t, realm)},
+    {str_init("method"), offsetof(sip_auth_t, method)},
+    {str_init("uri"), offsetof(sip_auth_t, uri)},
+    {str_init("nonce"), offsetof(sip_auth_t, nonce)},
+    {str_init("response"), offsetof(sip_auth_t, response)},
+    {str_init("algorithm"), offsetof(sip_auth_t, algorithm)},
+    {str_init("qop"), offsetof(sip_auth_t, qop)},
+    {str_init("cnonce"), offsetof(sip_auth_t, cnonce)},
+    {str_init("nc"), offsetof(sip_auth_t, nc)},
+};
+#define CRED_FIELD_COUNT (int)(sizeof(cred_fields) / sizeof(cred_fields[0]))
+
+#define cred_field(auth, i) ((const str*)((const char*)(auth) + cred_fields[i].offset))
+
+// Source of one contract argument: a credential field, copied directly,
+// or a pseudo-variable format evaluated per request
+typedef struct {
+    int field;              // index in cred_fields, -1 for a format
+    pv_elem_t* format;
+    int hash;               // send keccak256 of the value (hashed_ids)
+} arg_source_t;
+
+// Evaluation plan for the arguments of a contract method
+typedef struct {
+    int nargs;
+    arg_source_t src[WEB3_ABI_MAX_ARGS];
+} arg_plan_t;
+
+// Argument plans of the digest and HA1 methods, compiled in mod_init
+static arg_plan_t digest_plan;
+static arg_plan_t ha1_plan;
+
+// Credentials being verified by this process, for $web3auth(name)
+static const sip_auth_t* current_auth = NULL;
+
+// Reception time of the request an async worker is verifying, for the
+// rpc_budget of its RPCs
+static const struct timeval* async_received = NULL;
+
+// $web3auth(result): outcome of the latest check of the request being
+// processed, or of the check whose route is being resumed
+#define PV_WEB3AUTH_RESULT CRED_FIELD_COUNT
+static int last_result = 0;
+static unsigned int last_result_msg = 0;
+static int async_result = 0;
+static int async_resumed = 0;
+
+// $web3auth(body): eth_call body of this process's last
+// web3_auth_http_request(), -1 length when there is none
+#define PV_WEB3AUTH_BODY (CRED_FIELD_COUNT + 1)
+static char* http_body = NULL;
+static int http_body_size = 0;
+static int http_body_len = -1;
+
+// tm API, bound by the first fixup of an async check
+static struct tm_binds tmb;
+static int tm_loaded = 0;
+
+// A check handed to an async worker: the credentials and contract
+// arguments are copied into 'data', after which the SIP worker is free
+typedef struct web3_async_task {
+    unsigned int tindex;        // suspended transaction
+    unsigned int tlabel;
+    int route;                  // index in main_rt to resume
+    uint64_t received;          // reception time (ns) when traced, else 0
+    struct timeval tval;        // reception time, zero if unknown
+    int flow_id;                // connection to bind on success, or 0
+    sip_auth_t auth;
+    str values[WEB3_ABI_MAX_ARGS];
+    char data[];
+} web3_async_task_t;
+
+// Start a stage for the profiler and, if the check is traced, the tracer;
+// returns the trace start time to pass to stage_end()
+static inline uint64_t stage_begin(web3_stage_t stage) {
+    web3_prof_enter(stage);
+    return web3_trace_clock();
+}
+
+static inline void stage_end(web3_stage_t stage, uint64_t t, int code) {
+    web3_trace_stage(stage, t, code, 0);
+    web3_prof_exit(stage);
+}
+
 // Structure to hold response data from CURL
 struct ResponseData {
     char *memory;
     size_t size;
+    size_t result_pos;      // offset of the result value, 0 until seen
+    int complete;           // result value fully received
+    int too_large;          // body exceeded rpc_max_response
 };
 
 // Function prototypes
 static int web3_auth_check(struct sip_msg* msg, char* p1, char* p2);
 static int web3_auth_with_realm(struct sip_msg* msg, char* realm_param, char* p2);
+static int web3_auth_check_async(struct sip_msg* msg, char* route, char* p2);
+static int web3_auth_with_realm_async(struct sip_msg* msg, char* realm_param, char* route);
 static int mod_init(void);
+static int child_init(int rank);
 static void mod_destroy(void);
 
-// Rotate left function for Keccak
-static inline uint64_t rotl64(uint64_t x, int n) {
-    return (x << n) | (x >> (64 - n));
+// Callback function to write response data from CURL. Bodies (after
+// content decoding) larger than rpc_max_response abort the transfer, and
+// so does a complete "result" string: nothing after it is needed.
+static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, struct ResponseData *response) {
+    size_t realsize = size * nmemb;
+    size_t old_size = response->size;
+    
+    if (rpc_max_response > 0 && old_size + realsize > (size_t)rpc_max_response) {
+        response->too_large = 1;
+        return 0;
+    }
+    
+    char *ptr = web3_arena_realloc(&arena, response->memory,
+            response->memory ? old_size + 1 : 0, old_size + realsize + 1);
+    
+    if (!ptr) {
+        LM_ERR("Not enough memory for the RPC response\n");
+        return 0;
+    }
+    
+    response->memory = ptr;
+    memcpy(&(response->memory[old_size]), contents, realsize);
+    response->size += realsize;
+    response->memory[response->size] = 0;
+    
+    if (web3_json_result_scan(response->memory, old_size, response->size,
+            &response->result_pos)) {
+        response->complete = 1;
+        return 0;
+    }
+    
+    return realsize;
+}
+
+// Extract result from JSON response, into the request arena
+char *extract_result(const char *json, size_t json_len) {
+    const char *value;
+    size_t len;
+    
+    if (web3_json_result(json, json_len, &value, &len) < 0) return NULL;
+    
+    char *result = web3_arena_alloc(&arena, len + 1);
+    if (!result) return NULL;
+    
+    memcpy(result, value, len);
+    result[len] = '\0';
+    return result;
 }
 
-// Keccak permutation function
-static void keccak_f1600(uint64_t state[25]) {
-    for (int round = 0; round < KECCAK_ROUNDS; round++) {
-        // Theta step
-        uint64_t C[5];
-        for (int i = 0; i < 5; i++) {
-            C[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^ state[i + 20];
+// Find digest credentials of one header type (Authorization or
+// Proxy-Authorization) whose realm matches; realm NULL takes the first one.
+// Only headers up to the wanted type are parsed, walking further instances
+// with parse_headers(.., next=1) the same way the auth module does.
+// Returns 0 when found, 1 when not found, negative on parse error
+static int find_credentials(struct sip_msg* msg, str* realm, hdr_types_t hftype,
+        struct hdr_field** hdr) {
+    struct hdr_field** hook;
+    struct hdr_field* ptr;
+    struct hdr_field* prev;
+    hdr_flags_t hdr_flags;
+    auth_body_t* cred;
+    int res;
+
+    if (hftype == HDR_PROXYAUTH_T) {
+        hook = &msg->proxy_auth;
+        hdr_flags = HDR_PROXYAUTH_F;
+    } else {
+        hook = &msg->authorization;
+        hdr_flags = HDR_AUTHORIZATION_F;
+    }
+
+    if (*hook == NULL) {
+        if (parse_headers(msg, hdr_flags, 0) < 0) {
+            LM_ERR("Error parsing headers\n");
+            return -1;
         }
-        
-        for (int i = 0; i < 5; i++) {
-            uint64_t D = C[(i + 4) % 5] ^ rotl64(C[(i + 1) % 5], 1);
-            for (int j = 0; j < 25; j += 5) {
-                state[j + i] ^= D;
+    }
+
+    for (ptr = *hook; ptr; ) {
+        res = parse_credentials(ptr);
+        if (res < 0) {
+            LM_ERR("Error parsing authorization header\n");
+            return -1;
+        }
+        if (res == 0) {
+            cred = (auth_body_t*)ptr->parsed;
+            if (cred->digest.username.whole.len > 0
+                    && (realm == NULL
+                        || (cred->digest.realm.len == realm->len
+                            && strncasecmp(cred->digest.realm.s, realm->s,
+                                realm->len) == 0))) {
+                *hdr = ptr;
+                return 0;
             }
         }
-        
-        // Rho and Pi steps
-        uint64_t current = state[1];
-        for (int i = 0; i < 24; i++) {
-            int j = pi_offsets[i];
-            uint64_t temp = state[j];
-            state[j] = rotl64(current, rho_offsets[i]);
-            current = temp;
+
+        // Move on to the next header of the same type, if any
+        prev = ptr;
+        if (parse_headers(msg, hdr_flags, 1) < 0) {
+            LM_ERR("Error parsing headers\n");
+            return -1;
         }
-        
-        // Chi step
-        for (int j = 0; j < 25; j += 5) {
-            uint64_t t[5];
-            for (int i = 0; i < 5; i++) {
-                t[i] = state[j + i];
-            }
-            for (int i = 0; i < 5; i++) {
-                state[j + i] = t[i] ^ ((~t[(i + 1) % 5]) & t[(i + 2) % 5]);
-            }
+        if (prev == msg->last_header || msg->last_header->type != hftype) {
+            break;
         }
-        
-        // Iota step
-        state[0] ^= keccak_round_constants[round];
+        ptr = msg->last_header;
     }
+
+    return 1;
 }
 
-// Keccak-256 hash function
-void keccak256(const uint8_t *input, size_t input_len, uint8_t output[32]) {
-    uint64_t state[25] = {0};
-    uint8_t *state_bytes = (uint8_t *)state;
+// Extract authentication credentials from SIP message, matching realm
+// when given (NULL accepts the first credentials carrying a username)
+static int extract_credentials(struct sip_msg* msg, str* realm, sip_auth_t* auth) {
+    struct hdr_field* h = NULL;
+    auth_body_t* cred;
+    int ret;
+
+    ret = find_credentials(msg, realm, HDR_AUTHORIZATION_T, &h);
+    if (ret == 1) {
+        ret = find_credentials(msg, realm, HDR_PROXYAUTH_T, &h);
+    }
+
+    if (ret != 0) {
+        if (ret > 0) {
+            LM_ERR("No valid authorization header found\n");
+            return WEB3_AUTH_NO_CREDENTIALS;
+        }
+        return WEB3_AUTH_ERROR;
+    }
+
+    cred = (auth_body_t*)h->parsed;
+
+    // Extract credentials
+    auth->username = cred->digest.username.whole;
+    auth->realm = cred->digest.realm;
+    auth->uri = cred->digest.uri;
+    auth->nonce = cred->digest.nonce;
+    auth->response = cred->digest.response;
+    auth->algorithm = cred->digest.alg.alg_str;
+    auth->qop = cred->digest.qop.qop_str;
+    auth->cnonce = cred->digest.cnonce;
+    auth->nc = cred->digest.nc;
     
-    // Absorb phase
-    size_t rate = 136; // (1600 - 256) / 8 for Keccak-256
-    size_t offset = 0;
+    // Set method from SIP message
+    auth->method.s = msg->first_line.u.request.method.s;
+    auth->method.len = msg->first_line.u.request.method.len;
     
-    while (input_len >= rate) {
-        for (size_t i = 0; i < rate; i++) {
-            state_bytes[i] ^= input[offset + i];
+    return 0;
+}
+
+// Check that a digest field is present and fits without truncation
+static inline int field_ok(const str* f) {
+    return f->s != NULL && f->len > 0 && f->len < MAX_FIELD_SIZE;
+}
+
+// Check that a string is made of hex digits only
+static inline int is_hex_str(const str* f) {
+    for (int i = 0; i < f->len; i++) {
+        if (!isxdigit((unsigned char)f->s[i])) return 0;
+    }
+    return 1;
+}
+
+// Compare digest uri with the Request-URI as received (not as rewritten
+// by the script): byte equality first, then scheme, user, host and port
+// of the parsed URIs
+static int uri_matches_ruri(struct sip_msg* msg, const str* uri) {
+    str* ruri = &msg->first_line.u.request.uri;
+    struct sip_uri duri;
+    struct sip_uri puri;
+
+    if (uri->len == ruri->len && memcmp(uri->s, ruri->s, uri->len) == 0) {
+        return 1;
+    }
+
+    if (parse_uri(ruri->s, ruri->len, &puri) < 0 || parse_uri(uri->s, uri->len, &duri) < 0) {
+        return 0;
+    }
+
+    return duri.type == puri.type
+        && duri.port_no == puri.port_no
+        && duri.user.len == puri.user.len
+        && memcmp(duri.user.s, puri.user.s, duri.user.len) == 0
+        && duri.host.len == puri.host.len
+        && strncasecmp(duri.host.s, puri.host.s, duri.host.len) == 0;
+}
+
+// Local sanity checks run before any encoding or RPC work, so malformed
+// or unsupported credentials never reach the blockchain endpoint
+static int validate_credentials(struct sip_msg* msg, sip_auth_t* auth) {
+    // Missing algorithm parameter means MD5
+    auth->alg = DIGEST_MD5;
+    if (auth->algorithm.len > 0) {
+        for (auth->alg = 0; auth->alg < DIGEST_ALG_COUNT; auth->alg++) {
+            const str* name = &digest_algs[auth->alg].name;
+            if (auth->algorithm.len == name->len
+                    && strncasecmp(auth->algorithm.s, name->s, name->len) == 0) {
+                break;
+            }
+        }
+        if (auth->alg == DIGEST_ALG_COUNT) {
+            LM_WARN("Unsupported digest algorithm: %.*s\n",
+                    auth->algorithm.len, auth->algorithm.s);
+            update_stat(stat_unsupported, 1);
+            return WEB3_AUTH_UNSUPPORTED;
         }
-        keccak_f1600(state);
-        offset += rate;
-        input_len -= rate;
     }
-    
-    // Final block with remaining input
-    for (size_t i = 0; i < input_len; i++) {
-        state_bytes[i] ^= input[offset + i];
+
+    if (auth->response.len != digest_algs[auth->alg].hex_len
+            || web3_hex_decode(auth->response.s, auth->response.len,
+                auth->response_bin) < 0) {
+        LM_WARN("Invalid digest response (length %d)\n", auth->response.len);
+        update_stat(stat_malformed, 1);
+        return WEB3_AUTH_MALFORMED;
     }
-    
-    // Padding
-    state_bytes[input_len] ^= 0x01;
-    state_bytes[rate - 1] ^= 0x80;
-    
-    // Final permutation
-    keccak_f1600(state);
-    
-    // Extract output
-    memcpy(output, state_bytes, 32);
+
+    if (!field_ok(&auth->username) || !field_ok(&auth->realm)
+            || !field_ok(&auth->nonce) || !field_ok(&auth->uri)
+            || auth->method.len >= MAX_FIELD_SIZE) {
+        LM_WARN("Missing or oversized digest field\n");
+        update_stat(stat_malformed, 1);
+        return WEB3_AUTH_MALFORMED;
+    }
+
+    if (auth->qop.len > 0) {
+        if (auth->qop.len != 4 || strncasecmp(auth->qop.s, "auth", 4) != 0) {
+            LM_WARN("Unsupported digest qop: %.*s\n", auth->qop.len, auth->qop.s);
+            update_stat(stat_unsupported, 1);
+            return WEB3_AUTH_UNSUPPORTED;
+        }
+        if (!field_ok(&auth->cnonce) || auth->nc.len != NC_LEN
+                || !is_hex_str(&auth->nc)) {
+            LM_WARN("Missing or invalid cnonce/nc for qop=auth\n");
+            update_stat(stat_malformed, 1);
+            return WEB3_AUTH_MALFORMED;
+        }
+        // The nonce keys its nonce-count record
+        if (auth->nonce.len > WEB3_CACHE_KEY_SIZE) {
+            LM_WARN("Nonce too long for qop=auth (length %d)\n", auth->nonce.len);
+            update_stat(stat_malformed, 1);
+            return WEB3_AUTH_MALFORMED;
+        }
+        // A reused nonce is only safe while its nonce-counts are tracked
+        // for as long as it is valid
+        if (!nc_cache || !check_nonce) {
+            LM_WARN("qop=auth needs nc_cache_size and check_nonce\n");
+            update_stat(stat_unsupported, 1);
+            return WEB3_AUTH_UNSUPPORTED;
+        }
+    }
+
+    auth->nonce_expires = 0;
+    if (check_nonce) {
+        unsigned int now = (unsigned int)time(NULL);
+        int fresh = web3_nonce_check(auth->nonce.s, auth->nonce.len, now,
+                nonce_expire, &auth->nonce_expires);
+        if (fresh != 1) {
+            LM_INFO("%s nonce %.*s\n", fresh < 0 ? "Unknown" : "Stale",
+                    auth->nonce.len, auth->nonce.s);
+            update_stat(stat_stale_nonces, 1);
+            return WEB3_AUTH_STALE_NONCE;
+        }
+    }
+
+    if (check_uri && !uri_matches_ruri(msg, &auth->uri)) {
+        LM_WARN("Digest uri %.*s does not match Request-URI\n",
+                auth->uri.len, auth->uri.s);
+        update_stat(stat_uri_mismatch, 1);
+        return WEB3_AUTH_URI_MISMATCH;
+    }
+
+    return WEB3_AUTH_OK;
 }
 
-// Calculate function selector from function signature
-char* get_function_selector(const char* function_signature) {
-    uint8_t hash[32];
-    keccak256((const uint8_t*)function_signature, strlen(function_signature), hash);
-    
-    // Take first 4 bytes and convert to hex string
-    char* selector = pkg_malloc(11); // "0x" + 8 hex chars + null terminator
-    if (!selector) return NULL;
-    
-    snprintf(selector, 11, "0x%02x%02x%02x%02x", 
-             hash[0], hash[1], hash[2], hash[3]);
-    
-    return selector;
+// Index of a credential field by name, -1 if unknown
+static int cred_field_index(const char* name, int len) {
+    for (int i = 0; i < CRED_FIELD_COUNT; i++) {
+        if (cred_fields[i].name.len == len && strncmp(cred_fields[i].name.s, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-// Helper function to pad string data to 32-byte boundaries
-char* pad_string_data(const char* str, size_t* padded_length) {
-    size_t len = strlen(str);
-    size_t padded_len = ((len + 31) / 32) * 32; // Round up to nearest 32 bytes
+// Compile a ';' separated list of argument formats. An argument that is
+// exactly $web3auth(name) is taken straight from the credentials, anything
+// else is evaluated as a pseudo-variable format.
+static int plan_compile(const char* spec, arg_plan_t* plan) {
+    const char* p = spec;
     
-    if (padded_len == 0) padded_len = 32;
-    
-    char* padded = pkg_malloc(padded_len * 2 + 1);
-    if (!padded) return NULL;
-    
-    memset(padded, '0', padded_len * 2);
-    
-    // Convert string to hex
-    for (size_t i = 0; i < len; i++) {
-        sprintf(padded + i * 2, "%02x", (unsigned char)str[i]);
+    memset(plan, 0, sizeof(*plan));
+    while (*p) {
+        const char* end = strchr(p, ';');
+        str item;
+        
+        if (!end) end = p + strlen(p);
+        while (p < end && *p == ' ') p++;
+        item.s = (char*)p;
+        item.len = end - p;
+        while (item.len > 0 && item.s[item.len - 1] == ' ') item.len--;
+        
+        if (plan->nargs == WEB3_ABI_MAX_ARGS) {
+            LM_ERR("Too many arguments in '%s'\n", spec);
+            return -1;
+        }
+        arg_source_t* src = &plan->src[plan->nargs++];
+        src->field = -1;
+        if (item.len > 11 && strncmp(item.s, "$web3auth(", 10) == 0
+                && item.s[item.len - 1] == ')') {
+            src->field = cred_field_index(item.s + 10, item.len - 11);
+        }
+        if (src->field < 0 && (item.len == 0 || pv_parse_format(&item, &src->format) < 0)) {
+            LM_ERR("Invalid argument '%.*s' in '%s'\n", item.len, item.s, spec);
+            return -1;
+        }
+        
+        p = *end ? end + 1 : end;
     }
-    
-    // Fill the rest with zeros
-    for (size_t i = len * 2; i < padded_len * 2; i++) {
-        padded[i] = '0';
+    return 0;
+}
+
+static void plan_free(arg_plan_t* plan) {
+    for (int i = 0; i < plan->nargs; i++) {
+        if (plan->src[i].format) pv_elem_free_all(plan->src[i].format);
     }
-    
-    padded[padded_len * 2] = '\0';
-    *padded_length = padded_len;
-    return padded;
+    plan->nargs = 0;
 }
 
-// Encode call data for getDigestHash(string,string,string,string,string)
-char* encode_digest_hash_call(const char* str1, const char* str2, const char* str3, const char* str4, const char* str5) {
-    char* selector = get_function_selector("getDigestHash(string,string,string,string,string)");
-    if (!selector) return NULL;
-    
-    size_t len1 = strlen(str1), len2 = strlen(str2), len3 = strlen(str3), len4 = strlen(str4), len5 = strlen(str5);
-    size_t padded_len1, padded_len2, padded_len3, padded_len4, padded_len5;
-    
-    char* padded_str1 = pad_string_data(str1, &padded_len1);
-    char* padded_str2 = pad_string_data(str2, &padded_len2);
-    char* padded_str3 = pad_string_data(str3, &padded_len3);
-    char* padded_str4 = pad_string_data(str4, &padded_len4);
-    char* padded_str5 = pad_string_data(str5, &padded_len5);
-    
-    if (!padded_str1 || !padded_str2 || !padded_str3 || !padded_str4 || !padded_str5) {
-        if (selector) pkg_free(selector);
-        if (padded_str1) pkg_free(padded_str1);
-        if (padded_str2) pkg_free(padded_str2);
-        if (padded_str3) pkg_free(padded_str3);
-        if (padded_str4) pkg_free(padded_str4);
-        if (padded_str5) pkg_free(padded_str5);
-        return NULL;
+// Evaluate the argument values of a plan; formats are printed into 'buf'
+static int plan_eval(struct sip_msg* msg, const sip_auth_t* auth, const arg_plan_t* plan,
+        str* values, char buf[][MAX_FIELD_SIZE]) {
+    for (int i = 0; i < plan->nargs; i++) {
+        const arg_source_t* src = &plan->src[i];
+        
+        if (src->field >= 0) {
+            values[i] = *cred_field(auth, src->field);
+        } else {
+            values[i].s = buf[i];
+            values[i].len = MAX_FIELD_SIZE;
+            if (pv_printf(msg, src->format, buf[i], &values[i].len) < 0) {
+                LM_ERR("Failed to evaluate contract argument %d\n", i);
+                return WEB3_AUTH_ERROR;
+            }
+        }
+        if (src->hash) {
+            uint8_t hash[32];
+            keccak256((const uint8_t*)values[i].s, values[i].len, hash);
+            memcpy(buf[i], hash, sizeof(hash));
+            values[i].s = buf[i];
+            values[i].len = sizeof(hash);
+        }
     }
+    return WEB3_AUTH_OK;
+}
+
+// With hashed_ids, values of bytes32 arguments are sent as their keccak256
+static void plan_set_hashes(arg_plan_t* plan, const web3_abi_method_t* m) {
+    for (int i = 0; i < plan->nargs; i++) {
+        plan->src[i].hash = hashed_ids && m->args[i].type == WEB3_ABI_BYTES_N
+            && m->args[i].size == 32;
+    }
+}
+
+#define ETH_CALL_PREFIX "{\"jsonrpc\":\"2.0\",\"method\":\"eth_call\",\"params\":[{\"to\":\""
+#define ETH_CALL_DATA "\",\"data\":\"0x"
+#define ETH_CALL_SUFFIX "\"},\"latest\"],\"id\":1}"
+
+// Allocate a JSON-RPC eth_call payload with room for 'data_len' hex chars
+// of call data at 'data_offset'; everything else is filled in. Taken from
+// 'a' for one request, from pkg memory for a template when 'a' is NULL
+static char* eth_call_payload(web3_arena_t* a, int data_len, int* data_offset) {
+    int addr_len = strlen(contract_address);
+    size_t size = sizeof(ETH_CALL_PREFIX) - 1 + addr_len
+            + sizeof(ETH_CALL_DATA) - 1 + data_len + sizeof(ETH_CALL_SUFFIX);
+    char* payload = a ? web3_arena_alloc(a, size) : pkg_malloc(size);
+    char* p = payload;
     
-    size_t offset1 = 0xA0;
-    size_t offset2 = offset1 + 32 + padded_len1;
-    size_t offset3 = offset2 + 32 + padded_len2;
-    size_t offset4 = offset3 + 32 + padded_len3;
-    size_t offset5 = offset4 + 32 + padded_len4;
-    
-    size_t total_size = 8 + (64 * 5) + (64 * 5) + strlen(padded_str1) + strlen(padded_str2) + 
-                       strlen(padded_str3) + strlen(padded_str4) + strlen(padded_str5) + 1;
-    char* call_data = pkg_malloc(total_size);
-    
-    if (!call_data) {
-        pkg_free(selector);
-        pkg_free(padded_str1); pkg_free(padded_str2); pkg_free(padded_str3); 
-        pkg_free(padded_str4); pkg_free(padded_str5);
+    if (!payload) {
+        LM_ERR("No more pkg memory\n");
         return NULL;
     }
     
-    snprintf(call_data, total_size,
-        "%s"                              // function selector
-        "%064lx"                          // offset to string 1
-        "%064lx"                          // offset to string 2
-        "%064lx"                          // offset to string 3
-        "%064lx"                          // offset to string 4
-        "%064lx"                          // offset to string 5
-        "%064lx%s"                        // length + data for string 1
-        "%064lx%s"                        // length + data for string 2
-        "%064lx%s"                        // length + data for string 3
-        "%064lx%s"                        // length + data for string 4
-        "%064lx%s",                       // length + data for string 5
-        selector + 2,                     // remove "0x" prefix
-        offset1, offset2, offset3, offset4, offset5,
-        len1, padded_str1,
-        len2, padded_str2,
-        len3, padded_str3,
-        len4, padded_str4,
-        len5, padded_str5);
-    
-    pkg_free(selector);
-    pkg_free(padded_str1); pkg_free(padded_str2); pkg_free(padded_str3); 
-    pkg_free(padded_str4); pkg_free(padded_str5);
-    
-    return call_data;
-}
-
-// Callback function to write response data from CURL
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, struct ResponseData *response) {
-    size_t realsize = size * nmemb;
-    char *ptr = realloc(response->memory, response->size + realsize + 1);
-    
-    if (!ptr) {
-        LM_ERR("Not enough memory (realloc returned NULL)\n");
-        return 0;
+    memcpy(p, ETH_CALL_PREFIX, sizeof(ETH_CALL_PREFIX) - 1);
+    p += sizeof(ETH_CALL_PREFIX) - 1;
+    memcpy(p, contract_address, addr_len);
+    p += addr_len;
+    memcpy(p, ETH_CALL_DATA, sizeof(ETH_CALL_DATA) - 1);
+    p += sizeof(ETH_CALL_DATA) - 1;
+    *data_offset = p - payload;
+    memcpy(p + data_len, ETH_CALL_SUFFIX, sizeof(ETH_CALL_SUFFIX));
+    return payload;
+}
+
+#define ADAPTIVE_MIN_SAMPLES 16
+
+// Per-process RPC latency estimate in ms: smoothed mean and mean
+// deviation, updated like the TCP round trip estimators (RFC 6298)
+static long rpc_srtt = 0;
+static long rpc_rttvar = 0;
+static int rpc_samples = 0;
+
+static void rpc_latency_update(long ms) {
+    if (rpc_samples++ == 0) {
+        rpc_srtt = ms;
+        rpc_rttvar = ms / 2;
+        return;
     }
-    
-    response->memory = ptr;
-    memcpy(&(response->memory[response->size]), contents, realsize);
-    response->size += realsize;
-    response->memory[response->size] = 0;
-    
-    return realsize;
+    long err = ms - rpc_srtt;
+    rpc_srtt += err / 8;
+    rpc_rttvar += ((err < 0 ? -err : err) - rpc_rttvar) / 4;
 }
 
-// Extract result from JSON response
-char *extract_result(const char *json) {
-    const char *pattern = "\"result\":\"";
-    char *result_start = strstr(json, pattern);
-    if (!result_start) return NULL;
-    
-    result_start += strlen(pattern);
-    char *result_end = strchr(result_start, '"');
-    if (!result_end) return NULL;
+static inline long elapsed_ms(const struct timeval* from, const struct timeval* to) {
+    return (to->tv_sec - from->tv_sec) * 1000L + (to->tv_usec - from->tv_usec) / 1000L;
+}
+
+// Total timeout in ms for an RPC made while handling 'msg' (NULL in an
+// async worker). In adaptive mode it is cut to what is left of rpc_budget
+// since the request was received; -1 when less is left than an RPC
+// usually takes, as the client would have given up before the answer
+static long rpc_deadline(struct sip_msg* msg) {
+    const struct timeval* received = async_received;
+    struct timeval now;
+    long remaining;
     
-    size_t len = result_end - result_start;
-    char *result = pkg_malloc(len + 1);
-    if (!result) return NULL;
+    if (!rpc_adaptive_timeout) {
+        return rpc_timeout;
+    }
+    if (msg) {
+        received = msg_set_time(msg) < 0 ? NULL : &msg->tval;
+    }
+    if (!received) {
+        return rpc_timeout;
+    }
     
-    memcpy(result, result_start, len);
-    result[len] = '\0';
-    return result;
+    gettimeofday(&now, NULL);
+    remaining = rpc_budget - elapsed_ms(received, &now);
+    if (remaining <= 0 || (rpc_samples >= ADAPTIVE_MIN_SAMPLES && remaining < rpc_srtt)) {
+        return -1;
+    }
+    return (rpc_timeout <= 0 || remaining < rpc_timeout) ? remaining : rpc_timeout;
 }
 
-// Strip trailing zeros from hash result (take first 32 hex chars)
-void strip_trailing_zeros(const char* hex_result, char* stripped, size_t stripped_size) {
-    if (!hex_result || strlen(hex_result) < 66) {
-        strcpy(stripped, "");
-        return;
+// Record a phase lasting from 'from' to 'to' us into the transfer; if the
+// check is traced, also as a child span of the RPC span 'span' that
+// started at 'start_ns'
+static void rpc_phase_add(rpc_phase_t phase, curl_off_t from, curl_off_t to,
+        const uint8_t* span, uint64_t start_ns) {
+    web3_hist_t* h = web3_hist_get(rpc_hist, process_no, phase);
+    
+    if (to < from) return;
+    if (h) web3_hist_record(h, (uint64_t)(to - from));
+    if (phase != RPC_PHASE_TOTAL) {
+        // the phases are listed in the same order in both enums
+        web3_trace_span(WEB3_STAGE_RPC_DNS + phase, NULL, span,
+                start_ns + from * 1000, start_ns + to * 1000, 0, 0);
     }
+}
+
+// Record the phase durations of a finished transfer. curl reports times
+// cumulated from the start, so each phase is the difference to the
+// previous one; phases that did not happen are skipped.
+static void rpc_record_timings(CURL* curl, const uint8_t* span, uint64_t start_ns) {
+    curl_off_t lookup = 0, connect = 0, tls = 0, pretransfer = 0, start = 0, total = 0;
     
-    size_t copy_len = 32;
-    if (copy_len >= stripped_size) copy_len = stripped_size - 1;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &lookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &start);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
     
-    memcpy(stripped, hex_result + 2, copy_len);
-    stripped[copy_len] = '\0';
+    rpc_phase_add(RPC_PHASE_DNS, 0, lookup, span, start_ns);
+    if (connect > 0) rpc_phase_add(RPC_PHASE_CONNECT, lookup, connect, span, start_ns);
+    if (tls > 0) rpc_phase_add(RPC_PHASE_TLS, connect, tls, span, start_ns);
+    if (start > 0) {
+        rpc_phase_add(RPC_PHASE_SERVER, pretransfer, start, span, start_ns);
+        rpc_phase_add(RPC_PHASE_TRANSFER, start, total, span, start_ns);
+    }
+    rpc_phase_add(RPC_PHASE_TOTAL, 0, total, span, start_ns);
 }
 
-// Extract authentication credentials from SIP message
-static int extract_credentials(struct sip_msg* msg, sip_auth_t* auth) {
-    struct hdr_field* h;
-    struct auth_body* cred = NULL;
+// Progress state for the TLS handshake timeout
+struct rpc_progress {
+    CURL* curl;
+    struct timeval start;
+};
+
+// Abort when the TLS handshake takes longer than rpc_tls_timeout after
+// the TCP connect; libcurl has no option of its own for this phase
+static int rpc_progress_cb(void* p, curl_off_t dltotal, curl_off_t dlnow,
+        curl_off_t ultotal, curl_off_t ulnow) {
+    struct rpc_progress* progress = p;
+    curl_off_t connect_us = 0, appconnect_us = 0;
+    struct timeval now;
     
-    // Parse all headers
-    if (parse_headers(msg, HDR_EOH_F, 0) < 0) {
-        LM_ERR("Error parsing headers\n");
-        return -1;
-    }
+    curl_easy_getinfo(progress->curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+    if (connect_us == 0) return 0;
+    curl_easy_getinfo(progress->curl, CURLINFO_APPCONNECT_TIME_T, &appconnect_us);
+    if (appconnect_us > 0) return 0;
     
-    // Look for Authorization or Proxy-Authorization header
-    for (h = msg->headers; h; h = h->next) {
-        if (h->type == HDR_AUTHORIZATION_T || h->type == HDR_PROXYAUTH_T) {
-            cred = (struct auth_body*)h->parsed;
-            if (!cred) {
-                if (parse_authorization_header(msg, h) < 0) {
-                    LM_ERR("Error parsing authorization header\n");
-                    continue;
-                }
-                cred = (struct auth_body*)h->parsed;
-            }
-            if (cred && cred->digest.username.s) {
-                break;
-            }
-        }
+    gettimeofday(&now, NULL);
+    if (elapsed_ms(&progress->start, &now) - connect_us / 1000 > rpc_tls_timeout) {
+        LM_ERR("TLS handshake with RPC server exceeded %d ms\n", rpc_tls_timeout);
+        return 1;
     }
+    return 0;
+}
+
+// JSON-RPC eth_call payload of contract method 'cm' with argument
+// 'values': the method's template, or a payload built in the request arena
+static char* eth_call_encode(const contract_method_t* cm, const str* values) {
+    const web3_abi_method_t* m = &cm->abi;
+    int data_len = web3_abi_encoded_len(m, values);
+    int data_offset = cm->data_offset;
+    char* payload = cm->payload;
+    uint64_t t;
     
-    if (!cred || !cred->digest.username.s) {
-        LM_ERR("No valid authorization header found\n");
-        return -1;
+    t = stage_begin(WEB3_STAGE_ENCODE);
+    if (!payload) {
+        payload = eth_call_payload(&arena, data_len, &data_offset);
     }
+    if (payload && web3_abi_encode(m, values, payload + data_offset) != data_len) {
+        LM_ERR("Error encoding call data for %s\n", m->signature);
+        payload = NULL;
+    }
+    stage_end(WEB3_STAGE_ENCODE, t, data_len);
+    return payload;
+}
+
+// Outcome of an eth_call response body of 'len' bytes (NUL terminated);
+// on success the hex result (in the request arena) is set in 'result_hex'
+static int rpc_parse_response(const char* body, size_t len, char** result_hex) {
+    int rpc_result = WEB3_AUTH_ERROR;
+    uint64_t t;
     
-    // Extract credentials
-    auth->username = cred->digest.username;
-    auth->realm = cred->digest.realm;
-    auth->uri = cred->digest.uri;
-    auth->nonce = cred->digest.nonce;
-    auth->response = cred->digest.response;
-    
-    // Set method from SIP message
-    auth->method.s = msg->first_line.u.request.method.s;
-    auth->method.len = msg->first_line.u.request.method.len;
+    t = stage_begin(WEB3_STAGE_PARSE);
+    LM_INFO("Blockchain response: %s\n", body);
     
-    return 0;
+    // Check for error in response
+    if (strstr(body, "\"error\"")) {
+        if (strstr(body, "User not found")) {
+            LM_WARN("User not found in contract - authorization rejected\n");
+            rpc_result = WEB3_AUTH_USER_UNKNOWN;
+        } else {
+            LM_ERR("Error returned by contract call\n");
+        }
+    } else {
+        // Extract result
+        *result_hex = extract_result(body, len);
+        if (*result_hex) {
+            LM_INFO("Raw blockchain result: %s\n", *result_hex);
+            rpc_result = WEB3_AUTH_OK;
+        } else {
+            LM_ERR("Could not extract result from blockchain response\n");
+        }
+    }
+    stage_end(WEB3_STAGE_PARSE, t, rpc_result);
+    return rpc_result;
 }
 
-// Make RPC call to verify authentication against blockchain
-static int verify_sip_auth(const sip_auth_t* auth) {
+// Send an eth_call of contract method 'cm' with argument 'values' and
+// return the hex result (in the request arena) in 'result_hex'. The call data is
+// ABI encoded straight into the JSON-RPC payload, either the method's
+// fixed template or one sized exactly for these values.
+static int rpc_eth_call(struct sip_msg* msg, const contract_method_t* cm, const str* values,
+        char** result_hex) {
     CURL *curl;
     CURLcode res;
     struct ResponseData response = {0};
-    int auth_result = -1;
-    
-    // Convert str to null-terminated strings
-    char username[MAX_FIELD_SIZE], realm[MAX_FIELD_SIZE], method[MAX_FIELD_SIZE];
-    char uri[MAX_FIELD_SIZE], nonce[MAX_FIELD_SIZE], client_response[MAX_FIELD_SIZE];
-    
-    snprintf(username, sizeof(username), "%.*s", auth->username.len, auth->username.s);
-    snprintf(realm, sizeof(realm), "%.*s", auth->realm.len, auth->realm.s);
-    snprintf(method, sizeof(method), "%.*s", auth->method.len, auth->method.s);
-    snprintf(uri, sizeof(uri), "%.*s", auth->uri.len, auth->uri.s);
-    snprintf(nonce, sizeof(nonce), "%.*s", auth->nonce.len, auth->nonce.s);
-    snprintf(client_response, sizeof(client_response), "%.*s", auth->response.len, auth->response.s);
-    
-    LM_INFO("Web3 Auth: username=%s, realm=%s, method=%s, uri=%s, nonce=%s\n", 
-            username, realm, method, uri, nonce);
-    
-    // Encode call data (username, realm, method, uri, nonce)
-    char* call_data = encode_digest_hash_call(username, realm, method, uri, nonce);
-    if (!call_data) {
-        LM_ERR("Error encoding call data\n");
-        return -1;
+    struct rpc_progress progress;
+    int rpc_result = WEB3_AUTH_ERROR;
+    char* payload;
+    uint8_t span[WEB3_SPAN_ID_SIZE] = {0};
+    char traceparent[WEB3_TRACEPARENT_SIZE];
+    uint64_t t;
+    long timeout;
+    
+    *result_hex = NULL;
+    
+    timeout = rpc_deadline(msg);
+    if (timeout < 0) {
+        LM_WARN("Transaction budget exhausted, not calling the contract\n");
+        update_stat(stat_rpc_abandoned, 1);
+        return WEB3_AUTH_ERROR;
+    }
+    
+    payload = eth_call_encode(cm, values);
+    if (!payload) {
+        return WEB3_AUTH_ERROR;
     }
     
     // Initialize curl
     curl = curl_easy_init();
     if (!curl) {
         LM_ERR("Failed to initialize curl\n");
-        pkg_free(call_data);
-        return -1;
-    }
-    
-    // Prepare JSON-RPC payload
-    char* payload = pkg_malloc(8192);
-    if (!payload) {
-        curl_easy_cleanup(curl);
-        pkg_free(call_data);
-        return -1;
+        return WEB3_AUTH_ERROR;
     }
     
-    snprintf(payload, 8192,
-        "{\"jsonrpc\":\"2.0\",\"method\":\"eth_call\",\"params\":[{\"to\":\"%s\",\"data\":\"0x%s\"},\"latest\"],\"id\":1}",
-        contract_address, call_data);
-    
     // Set curl options
     curl_easy_setopt(curl, CURLOPT_URL, rpc_url);
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+    
+    // Timeouts in ms; no signals, the worker must not get SIGALRM
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout);
+    if (rpc_connect_timeout > 0) {
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)rpc_connect_timeout);
+    }
+    if (rpc_tls_timeout > 0 && strncasecmp(rpc_url, "https:", 6) == 0) {
+        progress.curl = curl;
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, rpc_progress_cb);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progress);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
+    
+    // Pin the addresses resolved in the background
+    struct curl_slist* resolve = web3_dns_resolve_list();
+    if (resolve) {
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve);
+    }
+    if (rpc_compression) {
+        // "" offers every encoding this libcurl can decode (gzip, deflate, ...)
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
+    if (rpc_max_response > 0) {
+        // Refused up front when the (compressed) Content-Length is larger
+        curl_easy_setopt(curl, CURLOPT_MAXFILESIZE, (long)rpc_max_response);
+    }
     
     // Set headers
     struct curl_slist *headers = NULL;
     headers = curl_slist_append(headers, "Content-Type: application/json");
+    if (web3_trace_clock()) {
+        // Lets a traced node link its side of the call to this trace
+        web3_trace_new_id(span);
+        web3_trace_traceparent(span, traceparent);
+        headers = curl_slist_append(headers, traceparent);
+    }
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     
     // Perform the request
+    gettimeofday(&progress.start, NULL);
+    t = stage_begin(WEB3_STAGE_RPC);
+    if (rpc_inflight) rpc_inflight[process_no] = 1;
     res = curl_easy_perform(curl);
+    if (rpc_inflight) rpc_inflight[process_no] = 0;
+    web3_prof_exit(WEB3_STAGE_RPC);
     
-    if (res == CURLE_OK) {
-        LM_INFO("Blockchain response: %s\n", response.memory);
-        
-        // Check for error in response
-        if (strstr(response.memory, "\"error\"")) {
-            if (strstr(response.memory, "User not found")) {
-                LM_WARN("User not found in contract - authorization rejected\n");
-            } else {
-                LM_ERR("Error getting digest hash from contract\n");
-            }
-            auth_result = -1;
-        } else {
-            // Extract result
-            char *result_hex = extract_result(response.memory);
-            if (result_hex) {
-                LM_INFO("Raw blockchain result: %s\n", result_hex);
-                
-                // Strip trailing zeros (take first 32 hex chars)
-                char expected_response[64];
-                strip_trailing_zeros(result_hex, expected_response, sizeof(expected_response));
-                
-                LM_INFO("Expected response: %s, Client response: %s\n", expected_response, client_response);
-                
-                // Compare responses
-                if (strcmp(expected_response, client_response) == 0) {
-                    LM_INFO("Web3 authentication successful - responses match!\n");
-                    auth_result = 1;
-                } else {
-                    LM_WARN("Web3 authentication failed - response mismatch\n");
-                    auth_result = -1;
-                }
-                
-                pkg_free(result_hex);
-            } else {
-                LM_ERR("Could not extract result from blockchain response\n");
-                auth_result = -1;
-            }
-        }
-        
-        if (response.memory) free(response.memory);
-    } else {
+    if (res == CURLE_OK || res == CURLE_OPERATION_TIMEDOUT || response.complete) {
+        curl_off_t total_us = 0;
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+        rpc_latency_update((long)(total_us / 1000));
+        rpc_record_timings(curl, span, t);
+    }
+    if (res == CURLE_OPERATION_TIMEDOUT) {
+        update_stat(stat_rpc_timeouts, 1);
+    }
+    
+    // Stopped by the write callback once the result was complete
+    if (res == CURLE_WRITE_ERROR && response.complete) {
+        res = CURLE_OK;
+    }
+    web3_trace_span(WEB3_STAGE_RPC, span, NULL, t, web3_trace_clock(), res, res != CURLE_OK);
+    
+    if (res == CURLE_OK && response.memory) {
+        rpc_result = rpc_parse_response(response.memory, response.size, result_hex);
+    } else if (response.too_large || res == CURLE_FILESIZE_EXCEEDED) {
+        LM_ERR("RPC response larger than %d bytes\n", rpc_max_response);
+    } else if (res != CURLE_OK) {
         LM_ERR("curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-        auth_result = -1;
     }
     
     // Cleanup
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
-    pkg_free(call_data);
-    pkg_free(payload);
     
-    return auth_result;
+    return rpc_result;
 }
 
-// Main authentication check function - called from Kamailio config
-static int web3_auth_check(struct sip_msg* msg, char* p1, char* p2) {
-    sip_auth_t auth = {0};
+// Compare the digest returned by the contract with the client's response
+static int digest_result_check(const sip_auth_t* auth, const char* result_hex) {
+    // The digest is left aligned in the returned bytes32 ("0x" + 64 hex)
+    uint8_t word[32];
+    int len = strlen(result_hex);
+    if (len < 2 || web3_abi_decode_word(result_hex + 2, len - 2, 0, word) < 0) {
+        LM_ERR("Invalid digest returned by contract\n");
+        return WEB3_AUTH_ERROR;
+    }
+    
+    LM_INFO("Expected response: %.32s, Client response: %.*s\n", result_hex + 2,
+            auth->response.len, auth->response.s);
+    
+    // Compare responses
+    if (memcmp(word, auth->response_bin, MD5_HEX_LEN / 2) == 0) {
+        LM_INFO("Web3 authentication successful - responses match!\n");
+        return WEB3_AUTH_OK;
+    }
+    
+    LM_WARN("Web3 authentication failed - response mismatch\n");
+    return WEB3_AUTH_INVALID_PASSWORD;
+}
+
+// Make RPC call to verify authentication against blockchain, with the
+// digest_args 'values'
+static int verify_sip_auth(struct sip_msg* msg, const sip_auth_t* auth, const str* values) {
+    int auth_result;
+    char* result_hex;
+    
+    LM_INFO("Web3 Auth: username=%.*s, realm=%.*s, method=%.*s, uri=%.*s, nonce=%.*s\n",
+            auth->username.len, auth->username.s, auth->realm.len, auth->realm.s,
+            auth->method.len, auth->method.s, auth->uri.len, auth->uri.s,
+            auth->nonce.len, auth->nonce.s);
+    
+    auth_result = rpc_eth_call(msg, &digest_call, values, &result_hex);
+    if (auth_result != WEB3_AUTH_OK) {
+        return auth_result;
+    }
+    return digest_result_check(auth, result_hex);
+}
+
+// Hash the concatenation of 'parts' with the digest algorithm
+static void digest_hash(digest_alg_t alg, const str* parts, int nparts, uint8_t* bin) {
+    MD5_CTX md5;
+    web3_sha256_ctx_t sha256;
+    web3_sha512_ctx_t sha512;
+    int i;
+    
+    switch (alg) {
+        case DIGEST_SHA256:
+            web3_sha256_init(&sha256);
+            for (i = 0; i < nparts; i++) {
+                web3_sha256_update(&sha256, parts[i].s, parts[i].len);
+            }
+            web3_sha256_final(&sha256, bin);
+            break;
+        case DIGEST_SHA512_256:
+            web3_sha512_256_init(&sha512);
+            for (i = 0; i < nparts; i++) {
+                web3_sha512_256_update(&sha512, parts[i].s, parts[i].len);
+            }
+            web3_sha512_256_final(&sha512, bin);
+            break;
+        default:
+            MD5Init(&md5);
+            for (i = 0; i < nparts; i++) {
+                MD5Update(&md5, parts[i].s, parts[i].len);
+            }
+            MD5Final(bin, &md5);
+            break;
+    }
+}
+
+// Calculate the expected digest response from HA1 (RFC 2617 section 3.2.2,
+// RFC 7616 section 3.4.1), in binary form
+static void calc_response(const char* ha1, const sip_auth_t* auth, uint8_t* response) {
+    static str colon = str_init(":");
+    int hex_len = digest_algs[auth->alg].hex_len;
+    uint8_t bin[MAX_DIGEST_HEX_LEN / 2];
+    char ha2[MAX_DIGEST_HEX_LEN];
+    str parts[11];
+    int n = 0;
+    uint64_t t = stage_begin(WEB3_STAGE_DIGEST);
+    
+    // HA2 = H(method:uri)
+    parts[0] = auth->method;
+    parts[1] = colon;
+    parts[2] = auth->uri;
+    digest_hash(auth->alg, parts, 3, bin);
+    web3_hex_encode(bin, hex_len / 2, ha2);
+    
+    // response = H(HA1:nonce[:nc:cnonce:qop]:HA2)
+    parts[n].s = (char*)ha1;
+    parts[n++].len = hex_len;
+    parts[n++] = colon;
+    parts[n++] = auth->nonce;
+    parts[n++] = colon;
+    if (auth->qop.len > 0) {
+        parts[n++] = auth->nc;
+        parts[n++] = colon;
+        parts[n++] = auth->cnonce;
+        parts[n++] = colon;
+        parts[n++] = auth->qop;
+        parts[n++] = colon;
+    }
+    parts[n].s = ha2;
+    parts[n++].len = hex_len;
+    digest_hash(auth->alg, parts, n, response);
+    stage_end(WEB3_STAGE_DIGEST, t, 0);
+}
+
+// Build the HA1 cache key: algorithm, then the contract arguments (by
+// default username and realm) separated by NUL
+static int ha1_cache_key(digest_alg_t alg, const str* values, int nvalues, char* buf, str* key) {
+    int len = 1;
+    
+    buf[0] = (char)('0' + alg);
+    for (int i = 0; i < nvalues; i++) {
+        if (len + (i > 0) + values[i].len > WEB3_CACHE_KEY_SIZE) {
+            return -1;
+        }
+        if (i > 0) buf[len++] = '\0';
+        memcpy(buf + len, values[i].s, values[i].len);
+        len += values[i].len;
+    }
+    key->s = buf;
+    key->len = len;
+    return 0;
+}
+
+// Lower case hex HA1 ('alg' length) from the result of an HA1 method
+static int ha1_result_decode(digest_alg_t alg, const char* result_hex, char* ha1) {
+    int hex_len = digest_algs[alg].hex_len;
+    
+    // HA1 is left aligned in the returned bytes32 ("0x" + 64 hex chars);
+    // decoding validates it and re-encoding gives the lower case form
+    // the response is computed over
+    uint8_t word[32];
+    int len = strlen(result_hex);
+    if (len < 2 || web3_abi_decode_word(result_hex + 2, len - 2, 0, word) < 0) {
+        LM_ERR("Invalid HA1 returned by contract\n");
+        return WEB3_AUTH_ERROR;
+    }
+    
+    // A contract returning zero for unmapped users, instead of reverting,
+    // must not make the well-known all-zero HA1 valid
+    int zero = 1;
+    for (int i = 0; i < hex_len / 2; i++) {
+        zero &= word[i] == 0;
+    }
+    if (zero) {
+        LM_WARN("Contract returned no HA1 for the user\n");
+        return WEB3_AUTH_USER_UNKNOWN;
+    }
+    
+    web3_hex_encode(word, hex_len / 2, ha1);
+    return WEB3_AUTH_OK;
+}
+
+// Fetch HA1 = H(username:realm:password) from the contract, using the
+// contract method of the credential's algorithm
+static int fetch_ha1(struct sip_msg* msg, digest_alg_t alg, const str* values, char* ha1) {
+    char* result_hex;
+    int ret;
+    
+    ret = rpc_eth_call(msg, &ha1_calls[alg], values, &result_hex);
+    if (ret != WEB3_AUTH_OK) {
+        return ret;
+    }
+    return ha1_result_decode(alg, result_hex, ha1);
+}
+
+// Look up the HA1 for 'auth' in the cache; 'key' is set whenever the
+// HA1 can be cached. Returns 1 when found
+static int ha1_lookup(const sip_auth_t* auth, const str* values, unsigned int now,
+        char* key_buf, str* key, char* ha1) {
+    int cached = 0;
+    
+    key->len = 0;
+    if (ha1_cache) {
+        uint64_t t = stage_begin(WEB3_STAGE_CACHE);
+        if (ha1_cache_key(auth->alg, values, ha1_plan.nargs, key_buf, key) == 0
+                && web3_cache_get(ha1_cache, key, now, ha1) == 0) {
+            cached = 1;
+        }
+        stage_end(WEB3_STAGE_CACHE, t, cached);
+        update_stat(cached ? stat_ha1_cache_hits : stat_ha1_cache_misses, 1);
+    }
+    return cached;
+}
+
+// Check the response of 'auth' against 'ha1', then its nonce-count;
+// a mismatch is left for the caller to report
+static int ha1_check(const sip_auth_t* auth, const char* ha1, unsigned int now) {
+    uint8_t expected[MAX_DIGEST_HEX_LEN / 2];
+    
+    calc_response(ha1, auth, expected);
+    if (memcmp(expected, auth->response_bin, digest_algs[auth->alg].hex_len / 2) != 0) {
+        return WEB3_AUTH_INVALID_PASSWORD;
+    }
+    
+    // With qop the nonce may be reused, but only with an increasing nc.
+    // The record lives as long as the nonce; when there is no room for
+    // it the client is sent for a new nonce
+    if (auth->qop.len > 0) {
+        unsigned int nc = 0;
+        int ret;
+        for (int i = 0; i < auth->nc.len; i++) {
+            char ch = auth->nc.s[i];
+            nc = (nc << 4) | (unsigned int)(isdigit((unsigned char)ch)
+                    ? ch - '0' : (tolower((unsigned char)ch) - 'a' + 10));
+        }
+        ret = web3_cache_nc_check(nc_cache, &auth->nonce, nc, now, auth->nonce_expires);
+        if (ret == 0) {
+            LM_WARN("Nonce-count %.*s not accepted for nonce %.*s\n",
+                    auth->nc.len, auth->nc.s, auth->nonce.len, auth->nonce.s);
+            update_stat(stat_nc_replays, 1);
+            return WEB3_AUTH_NONCE_REUSED;
+        }
+        if (ret < 0) {
+            LM_INFO("No room to track nonce %.*s\n", auth->nonce.len, auth->nonce.s);
+            update_stat(stat_stale_nonces, 1);
+            return WEB3_AUTH_STALE_NONCE;
+        }
+    }
+    
+    LM_INFO("Web3 authentication successful - responses match!\n");
+    return WEB3_AUTH_OK;
+}
+
+// Verify the response locally from HA1, taken from the cache or fetched
+// once from the contract; this is the only way to check qop=auth and the
+// SHA-2 algorithms
+static int verify_with_ha1(struct sip_msg* msg, const sip_auth_t* auth, const str* values) {
+    char key_buf[WEB3_CACHE_KEY_SIZE];
+    char ha1[MAX_DIGEST_HEX_LEN];
+    str key = {0, 0};
+    unsigned int now = (unsigned int)time(NULL);
+    int cached;
+    int ret;
+    
+    cached = ha1_lookup(auth, values, now, key_buf, &key, ha1);
+    if (!cached) {
+        ret = fetch_ha1(msg, auth->alg, values, ha1);
+        if (ret != WEB3_AUTH_OK) {
+            return ret;
+        }
+        if (key.len > 0) {
+            web3_cache_put(ha1_cache, &key, now + ha1_cache_ttl, ha1);
+        }
+    }
+    
+    ret = ha1_check(auth, ha1, now);
+    if (ret == WEB3_AUTH_INVALID_PASSWORD && cached) {
+        // HA1 may have changed on chain since it was cached
+        web3_cache_remove(ha1_cache, &key);
+        update_stat(stat_ha1_cache_misses, 1);
+        ret = fetch_ha1(msg, auth->alg, values, ha1);
+        if (ret != WEB3_AUTH_OK) {
+            return ret;
+        }
+        web3_cache_put(ha1_cache, &key, now + ha1_cache_ttl, ha1);
+        ret = ha1_check(auth, ha1, now);
+    }
+    if (ret == WEB3_AUTH_INVALID_PASSWORD) {
+        LM_WARN("Web3 authentication failed - response mismatch\n");
+    }
+    return ret;
+}
+
+// qop=auth and SHA-2 can only be checked locally from HA1, the rest
+// is verified against the blockchain
+#define auth_uses_ha1(auth) (ha1_mode || (auth)->qop.len > 0 || (auth)->alg != DIGEST_MD5)
+
+// Connection id of a request on a connection-oriented transport, to
+// which its identity can be bound; 0 for other transports
+static int flow_conn_id(struct sip_msg* msg) {
+    switch (msg->rcv.proto) {
+        case PROTO_TCP:
+        case PROTO_TLS:
+        case PROTO_WS:
+        case PROTO_WSS:
+            return msg->rcv.proto_reserved1;
+        default:
+            return 0;
+    }
+}
+
+// Digest of a user name or realm kept by the flow table
+static int flow_ident(const str* s, uint8_t* ident) {
+    uint8_t hash[32];
+    
+    if (s->len <= 0 || s->len >= MAX_FIELD_SIZE) return -1;
+    keccak256((const uint8_t*)s->s, s->len, hash);
+    memcpy(ident, hash, WEB3_FLOW_IDENT_SIZE);
+    return 0;
+}
+
+// Whether 'msg' is covered by the binding of its connection: it carries
+// no credentials and its From user is the bound user, in the bound realm
+// ('realm', when given, must be that realm). Credentials are always
+// verified. Bindings of closed connections are dropped
+static int flow_take(struct sip_msg* msg, str* realm) {
+    struct hdr_field* h = NULL;
+    struct sip_uri* from;
+    struct tcp_connection* con;
+    uint8_t user[WEB3_FLOW_IDENT_SIZE];
+    uint8_t realm_ident[WEB3_FLOW_IDENT_SIZE];
+    int id = flow_conn_id(msg);
+    int ret;
+    
+    if (!flow_table || id <= 0) return 0;
+    
+    ret = find_credentials(msg, realm, HDR_AUTHORIZATION_T, &h);
+    if (ret == 1) {
+        ret = find_credentials(msg, realm, HDR_PROXYAUTH_T, &h);
+    }
+    if (ret != 1 || (from = parse_from_uri(msg)) == NULL
+            || flow_ident(&from->user, user) < 0
+            || (realm && flow_ident(realm, realm_ident) < 0)) {
+        return 0;
+    }
+    
+    con = tcpconn_get(id, 0, 0, 0, 0);
+    if (!con || con->state == S_CONN_BAD) {
+        if (con) tcpconn_put(con);
+        web3_flow_unbind(flow_table, id);
+        return 0;
+    }
+    tcpconn_put(con);
+    
+    if (!web3_flow_take(flow_table, id, user, realm ? realm_ident : NULL,
+                (unsigned int)time(NULL))) {
+        return 0;
+    }
+    
+    LM_INFO("Request covered by the identity bound to connection %d\n", id);
+    update_stat(stat_flow_hits, 1);
+    return 1;
+}
+
+// Bind connection 'id' to the user and realm 'auth' was verified for
+static void flow_bind(int id, const sip_auth_t* auth) {
+    uint8_t user[WEB3_FLOW_IDENT_SIZE];
+    uint8_t realm[WEB3_FLOW_IDENT_SIZE];
+    
+    if (!flow_table || id <= 0 || flow_ident(&auth->username, user) < 0
+            || flow_ident(&auth->realm, realm) < 0) {
+        return;
+    }
+    web3_flow_bind(flow_table, id, user, realm,
+            (unsigned int)time(NULL) + flow_ttl, flow_max_requests > 0 ? (unsigned int)flow_max_requests : ~0u);
+}
+
+// Extract and validate the credentials of a request, then evaluate the
+// contract arguments of the method that will verify them. Formats are
+// printed into 'buf'; realm NULL accepts any realm
+static int web3_auth_prepare(struct sip_msg* msg, str* realm, sip_auth_t* auth,
+        str* values, char buf[][MAX_FIELD_SIZE]) {
+    uint64_t t;
+    int ret;
     
     LM_INFO("Web3 authentication check started\n");
     
-    // Extract credentials from SIP message headers
-    if (extract_credentials(msg, &auth) < 0) {
+    // Extract credentials from SIP message headers; credentials for other
+    // realms are skipped here, before any encoding or network work
+    t = stage_begin(WEB3_STAGE_EXTRACT);
+    ret = extract_credentials(msg, realm, auth);
+    stage_end(WEB3_STAGE_EXTRACT, t, ret);
+    if (ret < 0) {
         LM_ERR("Failed to extract credentials from SIP message\n");
-        return -1;
+        return ret;
+    }
+
+    t = stage_begin(WEB3_STAGE_VALIDATE);
+    ret = validate_credentials(msg, auth);
+    stage_end(WEB3_STAGE_VALIDATE, t, ret);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    // Arguments as configured by ha1_args or digest_args
+    current_auth = auth;
+    ret = plan_eval(msg, auth, auth_uses_ha1(auth) ? &ha1_plan : &digest_plan, values, buf);
+    current_auth = NULL;
+    return ret;
+}
+
+// Verify prepared credentials; 'msg' may be NULL when the check runs
+// away from the request (async worker)
+static int web3_auth_verify(struct sip_msg* msg, const sip_auth_t* auth, const str* values) {
+    int ret;
+    
+    current_auth = auth;
+    if (auth_uses_ha1(auth)) {
+        ret = verify_with_ha1(msg, auth, values);
+    } else {
+        ret = verify_sip_auth(msg, auth, values);
+    }
+    current_auth = NULL;
+    return ret;
+}
+
+// Authentication of one request; realm NULL accepts any realm
+static int web3_auth_run(struct sip_msg* msg, str* realm) {
+    sip_auth_t auth = {0};
+    str values[WEB3_ABI_MAX_ARGS];
+    char buf[WEB3_ABI_MAX_ARGS][MAX_FIELD_SIZE];
+    int ret;
+    
+    if (flow_take(msg, realm)) {
+        return WEB3_AUTH_OK;
     }
     
-    // Verify against blockchain
-    return verify_sip_auth(&auth);
+    ret = web3_auth_prepare(msg, realm, &auth, values, buf);
+    if (ret != WEB3_AUTH_OK) {
+        return ret;
+    }
+    ret = web3_auth_verify(msg, &auth, values);
+    if (ret == WEB3_AUTH_OK) {
+        flow_bind(flow_conn_id(msg), &auth);
+    }
+    return ret;
+}
+
+// Count a result not already counted where it was detected, and keep
+// it for $web3auth(result) while 'msg' (if any) is processed
+static void count_result(struct sip_msg* msg, int ret) {
+    if (msg) {
+        last_result = ret;
+        last_result_msg = msg->id;
+    }
+    switch (ret) {
+        case WEB3_AUTH_OK: update_stat(stat_auth_ok, 1); break;
+        case WEB3_AUTH_ERROR: update_stat(stat_auth_errors, 1); break;
+        case WEB3_AUTH_INVALID_PASSWORD: update_stat(stat_auth_invalid_password, 1); break;
+        case WEB3_AUTH_USER_UNKNOWN: update_stat(stat_auth_user_unknown, 1); break;
+        case WEB3_AUTH_NO_CREDENTIALS: update_stat(stat_auth_no_credentials, 1); break;
+        default: break;
+    }
+}
+
+// Reception time of a request in ns, when its check is sampled for tracing
+static uint64_t trace_received(struct sip_msg* msg) {
+    if (!tracing || msg_set_time(msg) != 0) return 0;
+    return (uint64_t)msg->tval.tv_sec * 1000000000ULL + (uint64_t)msg->tval.tv_usec * 1000ULL;
+}
+
+// Common authentication path, counting results not already counted
+// where they are detected
+static int web3_auth(struct sip_msg* msg, str* realm) {
+    uint64_t received = trace_received(msg);
+    int ret;
+    
+    // Sampled checks are traced from the reception of the request
+    if (received && web3_trace_begin(received)) {
+        web3_trace_stage(WEB3_STAGE_QUEUE, received, 0, 0);
+    }
+    
+    web3_prof_enter(WEB3_STAGE_AUTH);
+    ret = web3_auth_run(msg, realm);
+    web3_prof_exit(WEB3_STAGE_AUTH);
+    web3_arena_reset(&arena);
+    web3_trace_end(ret, ret == WEB3_AUTH_ERROR);
+    
+    count_result(msg, ret);
+    return ret;
+}
+
+// Main authentication check function - called from Kamailio config
+static int web3_auth_check(struct sip_msg* msg, char* p1, char* p2) {
+    return web3_auth(msg, NULL);
+}
+
+// Value of a realm parameter; must not be empty
+static int realm_param_get(struct sip_msg* msg, char* realm_param, str* realm) {
+    if (get_str_fparam(realm, msg, (fparam_t*)realm_param) < 0) {
+        LM_ERR("Failed to get realm value\n");
+        return -1;
+    }
+
+    if (realm->len <= 0) {
+        LM_ERR("Empty realm value\n");
+        return -1;
+    }
+    return 0;
 }
 
 // Authentication check with specific realm parameter
 static int web3_auth_with_realm(struct sip_msg* msg, char* realm_param, char* p2) {
-    // For now, just call the main auth function
-    // TODO: Implement realm-specific logic if needed
-    return web3_auth_check(msg, NULL, NULL);
+    str realm;
+
+    if (realm_param_get(msg, realm_param, &realm) < 0) {
+        return -1;
+    }
+    return web3_auth(msg, &realm);
+}
+
+// Run by an async worker: verify the copied credentials, then resume the
+// suspended transaction in the check's route with the outcome in
+// $web3auth(result). The worker frees the task afterwards
+static void web3_auth_async_exec(void* param) {
+    web3_async_task_t* task = param;
+    int ret;
+    
+    // Time spent waiting for a worker is the queue stage of the trace
+    if (task->received && web3_trace_begin(task->received)) {
+        web3_trace_stage(WEB3_STAGE_QUEUE, task->received, 0, 0);
+    }
+    
+    // Time spent in the queue counts against the rpc_budget
+    async_received = task->tval.tv_sec ? &task->tval : NULL;
+    web3_prof_enter(WEB3_STAGE_AUTH);
+    ret = web3_auth_verify(NULL, &task->auth, task->values);
+    web3_prof_exit(WEB3_STAGE_AUTH);
+    async_received = NULL;
+    web3_arena_reset(&arena);
+    web3_trace_end(ret, ret == WEB3_AUTH_ERROR);
+    count_result(NULL, ret);
+    if (ret == WEB3_AUTH_OK) {
+        flow_bind(task->flow_id, &task->auth);
+    }
+    
+    // The credentials stay readable as $web3auth(name) in the route
+    current_auth = &task->auth;
+    async_result = ret;
+    async_resumed = 1;
+    if (tmb.t_continue(task->tindex, task->tlabel, main_rt.rlist[task->route]) < 0) {
+        LM_ERR("Failed to resume transaction %u:%u\n", task->tindex, task->tlabel);
+    }
+    async_resumed = 0;
+    current_auth = NULL;
+}
+
+// Check a request in an async worker. Credentials are extracted and
+// validated here, so requests without usable ones are answered at once;
+// otherwise they are copied to shm with the contract arguments, the
+// transaction is suspended and 0 ends the script until 'route' resumes it
+static int web3_auth_async(struct sip_msg* msg, str* realm, int route) {
+    sip_auth_t auth = {0};
+    str values[WEB3_ABI_MAX_ARGS];
+    char buf[WEB3_ABI_MAX_ARGS][MAX_FIELD_SIZE];
+    str group = {async_group, strlen(async_group)};
+    web3_async_task_t* task;
+    async_task_t* at;
+    struct cell* t;
+    int nargs, size = 0;
+    char* p;
+    int ret;
+    
+    // Covered by a flow binding: nothing to hand off
+    if (flow_take(msg, realm)) {
+        count_result(msg, WEB3_AUTH_OK);
+        return WEB3_AUTH_OK;
+    }
+    
+    ret = web3_auth_prepare(msg, realm, &auth, values, buf);
+    if (ret != WEB3_AUTH_OK) {
+        count_result(msg, ret);
+        return ret;
+    }
+    nargs = auth_uses_ha1(&auth) ? ha1_plan.nargs : digest_plan.nargs;
+    
+    // One shm block for the async task, the check and what it points to
+    for (int i = 0; i < CRED_FIELD_COUNT; i++) size += cred_field(&auth, i)->len;
+    for (int i = 0; i < nargs; i++) size += values[i].len;
+    at = shm_malloc(sizeof(async_task_t) + sizeof(web3_async_task_t) + size);
+    if (!at) {
+        SHM_MEM_ERROR;
+        count_result(msg, WEB3_AUTH_ERROR);
+        return WEB3_AUTH_ERROR;
+    }
+    task = (web3_async_task_t*)(at + 1);
+    memset(task, 0, sizeof(*task));
+    task->auth = auth;
+    p = task->data;
+    for (int i = 0; i < CRED_FIELD_COUNT; i++) {
+        str* f = (str*)cred_field(&task->auth, i);
+        if (f->s) {
+            memcpy(p, f->s, f->len);
+            f->s = p;
+            p += f->len;
+        }
+    }
+    for (int i = 0; i < nargs; i++) {
+        memcpy(p, values[i].s, values[i].len);
+        task->values[i].s = p;
+        task->values[i].len = values[i].len;
+        p += values[i].len;
+    }
+    task->route = route;
+    task->received = trace_received(msg);
+    if (msg_set_time(msg) == 0) {
+        task->tval = msg->tval;
+    }
+    task->flow_id = flow_conn_id(msg);
+    at->exec = web3_auth_async_exec;
+    at->param = task;
+    
+    t = tmb.t_gett();
+    if ((t == NULL || t == T_UNDEFINED) && tmb.t_newtran(msg) < 0) {
+        LM_ERR("Failed to create transaction for async check\n");
+        goto error;
+    }
+    if (tmb.t_suspend(msg, &task->tindex, &task->tlabel) < 0) {
+        LM_ERR("Failed to suspend transaction for async check\n");
+        goto error;
+    }
+    if ((group.len > 0 ? async_task_group_push(&group, at) : async_task_push(at)) < 0) {
+        LM_ERR("Failed to hand check to async workers\n");
+        tmb.t_cancel_suspend(task->tindex, task->tlabel);
+        goto error;
+    }
+    return 0;
+    
+error:
+    shm_free(at);
+    count_result(msg, WEB3_AUTH_ERROR);
+    return WEB3_AUTH_ERROR;
+}
+
+// Async check resuming the given route - called from Kamailio config
+static int web3_auth_check_async(struct sip_msg* msg, char* route, char* p2) {
+    return web3_auth_async(msg, NULL, (int)(long)route);
+}
+
+// Async check with specific realm parameter
+static int web3_auth_with_realm_async(struct sip_msg* msg, char* realm_param, char* route) {
+    str realm;
+
+    if (realm_param_get(msg, realm_param, &realm) < 0) {
+        return -1;
+    }
+    return web3_auth_async(msg, &realm, (int)(long)route);
+}
+
+// Route of an async check, resolved to its index in main_rt. The tm API
+// is only needed by async checks and is bound on first use
+static int fixup_async_route(void** param) {
+    int ri;
+    
+    if (!tm_loaded) {
+        if (load_tm_api(&tmb) < 0) {
+            LM_ERR("Async checks need the tm module\n");
+            return -1;
+        }
+        tm_loaded = 1;
+    }
+    if (!async_group[0] && async_task_workers_active() == 0) {
+        LM_ERR("Async checks need async_workers to be set\n");
+        return -1;
+    }
+    
+    ri = route_lookup(&main_rt, (char*)*param);
+    if (ri < 0) {
+        LM_ERR("Route not found: %s\n", (char*)*param);
+        return -1;
+    }
+    *param = (void*)(long)ri;
+    return 0;
+}
+
+static int fixup_auth_async(void** param, int param_no) {
+    return param_no == 1 ? fixup_async_route(param) : 0;
+}
+
+static int fixup_auth_realm_async(void** param, int param_no) {
+    return param_no == 1 ? fixup_spve_null(param, 1) : fixup_async_route(param);
+}
+
+static int fixup_free_auth_realm_async(void** param, int param_no) {
+    return param_no == 1 ? fixup_free_spve_null(param, 1) : 0;
+}
+
+// First half of a check whose eth_call is sent by http_async_client.
+// Returns WEB3_AUTH_PENDING with the JSON-RPC body in $web3auth(body)
+// when the contract has to be asked, else the result, decided locally
+// (bad credentials, or a cached HA1 that verifies them)
+static int web3_auth_http(struct sip_msg* msg, str* realm) {
+    sip_auth_t auth = {0};
+    str values[WEB3_ABI_MAX_ARGS];
+    char buf[WEB3_ABI_MAX_ARGS][MAX_FIELD_SIZE];
+    char key_buf[WEB3_CACHE_KEY_SIZE];
+    char ha1[MAX_DIGEST_HEX_LEN];
+    str key = {0, 0};
+    unsigned int now = (unsigned int)time(NULL);
+    const contract_method_t* cm = &digest_call;
+    char* payload;
+    int len;
+    int ret;
+    
+    http_body_len = -1;
+    if (flow_take(msg, realm)) {
+        ret = WEB3_AUTH_OK;
+        goto done;
+    }
+    ret = web3_auth_prepare(msg, realm, &auth, values, buf);
+    if (ret != WEB3_AUTH_OK) {
+        goto done;
+    }
+    
+    if (auth_uses_ha1(&auth)) {
+        cm = &ha1_calls[auth.alg];
+        if (ha1_lookup(&auth, values, now, key_buf, &key, ha1)) {
+            ret = ha1_check(&auth, ha1, now);
+            if (ret == WEB3_AUTH_OK) {
+                flow_bind(flow_conn_id(msg), &auth);
+            }
+            if (ret != WEB3_AUTH_INVALID_PASSWORD) {
+                goto done;
+            }
+            // HA1 may have changed on chain since it was cached
+            web3_cache_remove(ha1_cache, &key);
+            update_stat(stat_ha1_cache_misses, 1);
+        }
+    }
+    
+    ret = WEB3_AUTH_ERROR;
+    payload = eth_call_encode(cm, values);
+    if (!payload) {
+        goto done;
+    }
+    len = strlen(payload);
+    if (len >= http_body_size) {
+        char* p = pkg_realloc(http_body, len + 1);
+        if (!p) {
+            PKG_MEM_ERROR;
+            goto done;
+        }
+        http_body = p;
+        http_body_size = len + 1;
+    }
+    memcpy(http_body, payload, len + 1);
+    http_body_len = len;
+    ret = WEB3_AUTH_PENDING;
+    
+done:
+    web3_arena_reset(&arena);
+    if (ret != WEB3_AUTH_PENDING) {
+        count_result(msg, ret);
+    }
+    return ret;
+}
+
+// Second half: the credentials are extracted again from the resumed
+// request and checked against the JSON-RPC response 'body'
+static int web3_auth_http_result(struct sip_msg* msg, str* body, str* realm) {
+    sip_auth_t auth = {0};
+    str values[WEB3_ABI_MAX_ARGS];
+    char buf[WEB3_ABI_MAX_ARGS][MAX_FIELD_SIZE];
+    char key_buf[WEB3_CACHE_KEY_SIZE];
+    char ha1[MAX_DIGEST_HEX_LEN];
+    str key = {0, 0};
+    unsigned int now = (unsigned int)time(NULL);
+    char* result_hex;
+    char* json;
+    int ret;
+    
+    ret = web3_auth_prepare(msg, realm, &auth, values, buf);
+    if (ret != WEB3_AUTH_OK) {
+        goto done;
+    }
+    
+    ret = WEB3_AUTH_ERROR;
+    if (body->len <= 0) {
+        LM_ERR("No RPC response\n");
+        goto done;
+    }
+    json = web3_arena_alloc(&arena, body->len + 1);
+    if (!json) {
+        goto done;
+    }
+    memcpy(json, body->s, body->len);
+    json[body->len] = '\0';
+    ret = rpc_parse_response(json, body->len, &result_hex);
+    if (ret != WEB3_AUTH_OK) {
+        goto done;
+    }
+    
+    if (!auth_uses_ha1(&auth)) {
+        ret = digest_result_check(&auth, result_hex);
+        goto done;
+    }
+    ret = ha1_result_decode(auth.alg, result_hex, ha1);
+    if (ret != WEB3_AUTH_OK) {
+        goto done;
+    }
+    if (ha1_cache && ha1_cache_key(auth.alg, values, ha1_plan.nargs, key_buf, &key) == 0) {
+        web3_cache_put(ha1_cache, &key, now + ha1_cache_ttl, ha1);
+    }
+    ret = ha1_check(&auth, ha1, now);
+    if (ret == WEB3_AUTH_INVALID_PASSWORD) {
+        LM_WARN("Web3 authentication failed - response mismatch\n");
+    }
+    
+done:
+    if (ret == WEB3_AUTH_OK) {
+        flow_bind(flow_conn_id(msg), &auth);
+    }
+    web3_arena_reset(&arena);
+    count_result(msg, ret);
+    return ret;
+}
+
+// eth_call body for http_async_client - called from Kamailio config
+static int web3_auth_http_request(struct sip_msg* msg, char* p1, char* p2) {
+    return web3_auth_http(msg, NULL);
+}
+
+static int web3_auth_http_request_realm(struct sip_msg* msg, char* realm_param, char* p2) {
+    str realm;
+
+    if (realm_param_get(msg, realm_param, &realm) < 0) {
+        return -1;
+    }
+    return web3_auth_http(msg, &realm);
+}
+
+// Check against the http_async_client response, e.g. $http_rb
+static int web3_auth_http_response(struct sip_msg* msg, char* body_param, char* p2) {
+    str body;
+
+    if (get_str_fparam(&body, msg, (fparam_t*)body_param) < 0) {
+        LM_ERR("Failed to get RPC response\n");
+        return -1;
+    }
+    return web3_auth_http_result(msg, &body, NULL);
+}
+
+static int web3_auth_http_response_realm(struct sip_msg* msg, char* body_param,
+        char* realm_param) {
+    str body;
+    str realm;
+
+    if (get_str_fparam(&body, msg, (fparam_t*)body_param) < 0) {
+        LM_ERR("Failed to get RPC response\n");
+        return -1;
+    }
+    if (realm_param_get(msg, realm_param, &realm) < 0) {
+        return -1;
+    }
+    return web3_auth_http_result(msg, &body, &realm);
+}
+
+// Drop the identity bound to the connection of a request, e.g. on
+// REGISTER with Expires: 0
+static int web3_auth_flow_unbind(struct sip_msg* msg, char* p1, char* p2) {
+    int id = flow_conn_id(msg);
+    
+    if (!flow_table || id <= 0) return -1;
+    web3_flow_unbind(flow_table, id);
+    return 1;
+}
+
+// $web3auth(name): field of the credentials being verified, usable in
+// digest_args and ha1_args; null outside of a check. $web3auth(result) is
+// the return code of the request's latest check (or of the async check
+// whose route is resumed), $web3auth(body) the JSON-RPC body of
+// web3_auth_http_request()
+static int pv_parse_web3auth_name(pv_spec_t* sp, str* in) {
+    int idx;
+    
+    if (!sp || !in || in->len <= 0) return -1;
+    
+    if (in->len == 6 && strncmp(in->s, "result", 6) == 0) {
+        idx = PV_WEB3AUTH_RESULT;
+    } else if (in->len == 4 && strncmp(in->s, "body", 4) == 0) {
+        idx = PV_WEB3AUTH_BODY;
+    } else {
+        idx = cred_field_index(in->s, in->len);
+    }
+    if (idx < 0) {
+        LM_ERR("Unknown $web3auth field: %.*s\n", in->len, in->s);
+        return -1;
+    }
+    sp->pvp.pvn.type = PV_NAME_INTSTR;
+    sp->pvp.pvn.u.isname.type = 0;
+    sp->pvp.pvn.u.isname.name.n = idx;
+    return 0;
+}
+
+static int pv_get_web3auth(struct sip_msg* msg, pv_param_t* param, pv_value_t* res) {
+    const str* f;
+    
+    if (param->pvn.u.isname.name.n == PV_WEB3AUTH_RESULT) {
+        if (async_resumed) return pv_get_sintval(msg, param, res, async_result);
+        if (!last_result || !msg || msg->id != last_result_msg) {
+            return pv_get_null(msg, param, res);
+        }
+        return pv_get_sintval(msg, param, res, last_result);
+    }
+    if (param->pvn.u.isname.name.n == PV_WEB3AUTH_BODY) {
+        str body = {http_body, http_body_len};
+        if (http_body_len < 0) return pv_get_null(msg, param, res);
+        return pv_get_strval(msg, param, res, &body);
+    }
+    if (!current_auth) return pv_get_null(msg, param, res);
+    
+    f = cred_field(current_auth, param->pvn.u.isname.name.n);
+    if (!f->s) return pv_get_null(msg, param, res);
+    return pv_get_strval(msg, param, res, (str*)f);
+}
+
+// Parse a contract method signature and, for methods with only static
+// arguments, build its payload template
+static int contract_method_init(const char* signature, contract_method_t* cm) {
+    if (web3_abi_parse(signature, &cm->abi) < 0) {
+        return -1;
+    }
+    if (cm->abi.ndynamic == 0) {
+        cm->payload = eth_call_payload(NULL, cm->abi.head_len, &cm->data_offset);
+        if (!cm->payload) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void contract_method_free(contract_method_t* cm) {
+    if (cm->payload) pkg_free(cm->payload);
+    cm->payload = NULL;
+}
+
+// Merged histogram of one RPC phase
+static unsigned long rpc_phase_avg(rpc_phase_t phase) {
+    web3_hist_t h;
+    web3_hist_merge(rpc_hist, phase, &h);
+    return h.total ? (unsigned long)(h.sum / h.total) : 0;
+}
+
+static unsigned long rpc_total_quantile(double q) {
+    web3_hist_t h;
+    web3_hist_merge(rpc_hist, RPC_PHASE_TOTAL, &h);
+    return (unsigned long)web3_hist_quantile(&h, q);
+}
+
+static unsigned long stat_rpc_dns_avg(void) { return rpc_phase_avg(RPC_PHASE_DNS); }
+static unsigned long stat_rpc_connect_avg(void) { return rpc_phase_avg(RPC_PHASE_CONNECT); }
+static unsigned long stat_rpc_tls_avg(void) { return rpc_phase_avg(RPC_PHASE_TLS); }
+static unsigned long stat_rpc_server_avg(void) { return rpc_phase_avg(RPC_PHASE_SERVER); }
+static unsigned long stat_rpc_transfer_avg(void) { return rpc_phase_avg(RPC_PHASE_TRANSFER); }
+static unsigned long stat_rpc_total_avg(void) { return rpc_phase_avg(RPC_PHASE_TOTAL); }
+static unsigned long stat_rpc_total_p50(void) { return rpc_total_quantile(0.5); }
+static unsigned long stat_rpc_total_p99(void) { return rpc_total_quantile(0.99); }
+
+static const char* rpc_latency_doc[2] = {
+    "Contract RPC latency by phase in microseconds: count, avg, p50, p90, p99, max",
+    0
+};
+
+// web3_auth.latency: one struct per phase, merged over all processes
+static void rpc_latency(rpc_t* rpc, void* ctx) {
+    web3_hist_t h;
+    void* th;
+    
+    for (int i = 0; i < RPC_PHASE_COUNT; i++) {
+        web3_hist_merge(rpc_hist, i, &h);
+        if (rpc->add(ctx, "{", &th) < 0) {
+            rpc->fault(ctx, 500, "Internal error creating reply");
+            return;
+        }
+        rpc->struct_add(th, "ssjjjjjj",
+                "endpoint", rpc_url,
+                "phase", rpc_phase_names[i],
+                "count", (unsigned long)h.total,
+                "avg", h.total ? (unsigned long)(h.sum / h.total) : 0UL,
+                "p50", (unsigned long)web3_hist_quantile(&h, 0.5),
+                "p90", (unsigned long)web3_hist_quantile(&h, 0.9),
+                "p99", (unsigned long)web3_hist_quantile(&h, 0.99),
+                "max", (unsigned long)h.max);
+    }
+}
+
+static const char* rpc_profile_doc[2] = {
+    "Time spent per stage of the checks as a call tree: calls, total and self "
+    "time in microseconds, self share of all profiled time. With \"folded\", "
+    "one \"stack self_us\" line per stage for flame graph tools",
+    0
+};
+
+// Call path of a (parent, stage) cell, e.g. "web3_auth;eth_call". Each
+// stage has one parent in practice, so the first one found is followed.
+static int profile_path(const web3_prof_t* prof, int parent, int stage,
+        char* buf, int size, int depth) {
+    int len = 0;
+    
+    if (parent != WEB3_PROF_ROOT && depth < WEB3_STAGE_COUNT) {
+        for (int gp = 0; gp <= WEB3_STAGE_COUNT; gp++) {
+            if (prof->cells[gp][parent].calls > 0) {
+                len = profile_path(prof, gp, parent, buf, size, depth + 1);
+                if (len < size) len += snprintf(buf + len, size - len, ";");
+                break;
+            }
+        }
+    }
+    if (len < size) len += snprintf(buf + len, size - len, "%s", web3_stage_names[stage]);
+    return len;
+}
+
+static void rpc_profile(rpc_t* rpc, void* ctx) {
+    static web3_prof_t prof;
+    double rate = web3_prof_tick_rate();
+    uint64_t all_self = 0;
+    char* mode = NULL;
+    char path[128];
+    void* th;
+    
+    if (web3_prof_merge(&prof) < 0) {
+        rpc->fault(ctx, 500, "Profiling is off (modparam profile)");
+        return;
+    }
+    if (rpc->scan(ctx, "*s", &mode) < 1) mode = NULL;
+    
+    for (int i = 0; i <= WEB3_STAGE_COUNT; i++) {
+        for (int j = 0; j < WEB3_STAGE_COUNT; j++) {
+            all_self += prof.cells[i][j].self_ticks;
+        }
+    }
+    
+    for (int i = 0; i <= WEB3_STAGE_COUNT; i++) {
+        for (int j = 0; j < WEB3_STAGE_COUNT; j++) {
+            const web3_prof_cell_t* c = &prof.cells[i][j];
+            if (c->calls == 0) continue;
+            profile_path(&prof, i, j, path, sizeof(path), 0);
+            if (mode && strcmp(mode, "folded") == 0) {
+                rpc->rpl_printf(ctx, "%s %lu", path, (unsigned long)(c->self_ticks / rate));
+                continue;
+            }
+            if (rpc->add(ctx, "{", &th) < 0) {
+                rpc->fault(ctx, 500, "Internal error creating reply");
+                return;
+            }
+            rpc->struct_add(th, "sjjjf",
+                    "stack", path,
+                    "calls", (unsigned long)c->calls,
+                    "total_us", (unsigned long)(c->ticks / rate),
+                    "self_us", (unsigned long)(c->self_ticks / rate),
+                    "self_pct", all_self ? 100.0 * c->self_ticks / all_self : 0.0);
+        }
+    }
+}
+
+static rpc_export_t rpc_cmds[] = {
+    {"web3_auth.latency", rpc_latency, rpc_latency_doc, RET_ARRAY},
+    {"web3_auth.profile", rpc_profile, rpc_profile_doc, RET_ARRAY},
+    {0, 0, 0, 0}
+};
+
+// Upper bounds of the exported latency buckets, in microseconds
+static const uint64_t metrics_le_us[] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000
+};
+#define METRICS_LE_COUNT (int)(sizeof(metrics_le_us) / sizeof(metrics_le_us[0]))
+
+static void metrics_counter(web3_metrics_buf_t* out, const char* name, const char* help) {
+    web3_metrics_printf(out, "# HELP web3_auth_%s %s\n# TYPE web3_auth_%s counter\n",
+            name, help, name);
+}
+
+// Render the Prometheus page; runs in the metrics process and only reads
+// the per-process counters and histograms
+static void metrics_render(web3_metrics_buf_t* out) {
+    static const struct {
+        const char* result;
+        stat_var** stat;
+    } results[] = {
+        {"ok", &stat_auth_ok},
+        {"invalid_password", &stat_auth_invalid_password},
+        {"user_unknown", &stat_auth_user_unknown},
+        {"no_credentials", &stat_auth_no_credentials},
+        {"malformed", &stat_malformed},
+        {"unsupported", &stat_unsupported},
+        {"uri_mismatch", &stat_uri_mismatch},
+        {"nonce_reused", &stat_nc_replays},
+        {"stale_nonce", &stat_stale_nonces},
+        {"error", &stat_auth_errors},
+    };
+    web3_hist_t h;
+    int inflight = 0;
+    
+    metrics_counter(out, "results_total", "Authentication results by outcome.");
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        web3_metrics_printf(out, "web3_auth_results_total{result=\"%s\"} %lu\n",
+                results[i].result, get_stat_val(*results[i].stat));
+    }
+    
+    metrics_counter(out, "ha1_cache_lookups_total", "HA1 cache lookups by outcome.");
+    web3_metrics_printf(out, "web3_auth_ha1_cache_lookups_total{outcome=\"hit\"} %lu\n",
+            get_stat_val(stat_ha1_cache_hits));
+    web3_metrics_printf(out, "web3_auth_ha1_cache_lookups_total{outcome=\"miss\"} %lu\n",
+            get_stat_val(stat_ha1_cache_misses));
+    
+    metrics_counter(out, "rpc_timeouts_total", "Contract RPCs that timed out.");
+    web3_metrics_printf(out, "web3_auth_rpc_timeouts_total %lu\n", get_stat_val(stat_rpc_timeouts));
+    metrics_counter(out, "rpc_abandoned_total", "Contract RPCs skipped for lack of time.");
+    web3_metrics_printf(out, "web3_auth_rpc_abandoned_total %lu\n", get_stat_val(stat_rpc_abandoned));
+    
+    for (int i = 0; i < rpc_inflight_procs; i++) {
+        inflight += rpc_inflight[i];
+    }
+    web3_metrics_printf(out, "# HELP web3_auth_rpc_in_flight Contract RPCs in progress.\n"
+            "# TYPE web3_auth_rpc_in_flight gauge\nweb3_auth_rpc_in_flight %d\n", inflight);
+    
+    web3_metrics_printf(out, "# HELP web3_auth_rpc_duration_seconds Contract RPC duration by phase.\n"
+            "# TYPE web3_auth_rpc_duration_seconds histogram\n");
+    for (int p = 0; p < RPC_PHASE_COUNT; p++) {
+        uint64_t cumulative = 0;
+        int b = 0;
+        
+        web3_hist_merge(rpc_hist, p, &h);
+        // a histogram bucket is counted under the first bound that
+        // holds all of its values
+        for (int i = 0; i < METRICS_LE_COUNT; i++) {
+            for (; b < WEB3_HIST_BUCKETS - 1
+                    && web3_hist_bucket_lower(b + 1) <= metrics_le_us[i] + 1; b++) {
+                cumulative += h.count[b];
+            }
+            web3_metrics_printf(out, "web3_auth_rpc_duration_seconds_bucket{endpoint=\"%s\","
+                    "phase=\"%s\",le=\"%g\"} %llu\n", rpc_url, rpc_phase_names[p],
+                    metrics_le_us[i] / 1e6, (unsigned long long)cumulative);
+        }
+        web3_metrics_printf(out, "web3_auth_rpc_duration_seconds_bucket{endpoint=\"%s\","
+                "phase=\"%s\",le=\"+Inf\"} %llu\n", rpc_url, rpc_phase_names[p],
+                (unsigned long long)h.total);
+        web3_metrics_printf(out, "web3_auth_rpc_duration_seconds_sum{endpoint=\"%s\","
+                "phase=\"%s\"} %.6f\n", rpc_url, rpc_phase_names[p], h.sum / 1e6);
+        web3_metrics_printf(out, "web3_auth_rpc_duration_seconds_count{endpoint=\"%s\","
+                "phase=\"%s\"} %llu\n", rpc_url, rpc_phase_names[p],
+                (unsigned long long)h.total);
+    }
 }
 
 // Module initialization function
@@ -518,16 +2169,227 @@ static int mod_init(void) {
         return -1;
     }
     
+    if (rpc_register_array(rpc_cmds) != 0) {
+        LM_ERR("Failed to register RPC commands\n");
+        return -1;
+    }
+    
+    // The first block is taken lazily, in each worker
+    if (arena_size < 256) arena_size = 256;
+    web3_arena_init(&arena, arena_size);
+    
+    // Prometheus endpoint in its own process
+    if (metrics_port > 0) {
+        register_procs(1);
+        cfg_register_child(1);
+    }
+    
+    // Span exporter timer; the rings are allocated in child_init(PROC_INIT)
+    if (trace_url && trace_url[0]) {
+        char* end;
+        trace_sample = strtod(trace_ratio, &end);
+        if (*end || trace_sample <= 0 || trace_sample > 1) {
+            LM_ERR("trace_ratio must be a number in (0, 1]: %s\n", trace_ratio);
+            return -1;
+        }
+        if (register_basic_utimers(1) < 0) {
+            LM_ERR("Failed to register span export timer\n");
+            return -1;
+        }
+        tracing = 1;
+    }
+    
+    // Resolve the RPC host now and keep it fresh from a timer process
+    if (dns_ttl > 0) {
+        int ret = web3_dns_init(rpc_url, dns_ttl);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            if (register_basic_timers(1) < 0) {
+                LM_ERR("Failed to register DNS timer\n");
+                return -1;
+            }
+            dns_timer = 1;
+        }
+    }
+    
+    // hashed_ids switches the default methods to their bytes32 id variants
+    if (hashed_ids) {
+        if (strcmp(digest_method, DEFAULT_DIGEST_METHOD) == 0) digest_method = HASHED_DIGEST_METHOD;
+        if (strcmp(ha1_method, DEFAULT_HA1_METHOD) == 0) ha1_method = HASHED_HA1_METHOD;
+        if (strcmp(ha1_sha256_method, DEFAULT_HA1_SHA256_METHOD) == 0) {
+            ha1_sha256_method = HASHED_HA1_SHA256_METHOD;
+        }
+        if (strcmp(ha1_sha512_256_method, DEFAULT_HA1_SHA512_256_METHOD) == 0) {
+            ha1_sha512_256_method = HASHED_HA1_SHA512_256_METHOD;
+        }
+    }
+    
+    // Contract methods: selector and argument layout are computed once here
+    if (contract_method_init(digest_method, &digest_call) < 0
+            || contract_method_init(ha1_method, &ha1_calls[DIGEST_MD5]) < 0
+            || contract_method_init(ha1_sha256_method, &ha1_calls[DIGEST_SHA256]) < 0
+            || contract_method_init(ha1_sha512_256_method, &ha1_calls[DIGEST_SHA512_256]) < 0) {
+        return -1;
+    }
+    
+    // Argument plans: which credential field or pseudo-variable feeds
+    // which contract argument
+    if (plan_compile(digest_args, &digest_plan) < 0
+            || plan_compile(ha1_args, &ha1_plan) < 0) {
+        return -1;
+    }
+    if (digest_call.abi.nargs != digest_plan.nargs) {
+        LM_ERR("%s takes %d arguments but digest_args has %d\n",
+                digest_call.abi.signature, digest_call.abi.nargs, digest_plan.nargs);
+        return -1;
+    }
+    for (int i = 0; i < DIGEST_ALG_COUNT; i++) {
+        if (ha1_calls[i].abi.nargs != ha1_plan.nargs) {
+            LM_ERR("%s takes %d arguments but ha1_args has %d\n",
+                    ha1_calls[i].abi.signature, ha1_calls[i].abi.nargs, ha1_plan.nargs);
+            return -1;
+        }
+    }
+    plan_set_hashes(&digest_plan, &digest_call.abi);
+    plan_set_hashes(&ha1_plan, &ha1_calls[DIGEST_MD5].abi);
+    for (int i = 0; i < DIGEST_ALG_COUNT; i++) {
+        for (int j = 0; j < ha1_plan.nargs; j++) {
+            const web3_abi_arg_t* arg = &ha1_calls[i].abi.args[j];
+            if (ha1_plan.src[j].hash != (hashed_ids && arg->type == WEB3_ABI_BYTES_N
+                    && arg->size == 32)) {
+                LM_ERR("HA1 methods differ in bytes32 argument %d\n", j);
+                return -1;
+            }
+        }
+    }
+    
+    // Shared caches for HA1 values and nonce-counts
+    if (ha1_cache_size > 0) {
+        ha1_cache = web3_cache_new(ha1_cache_size, MAX_DIGEST_HEX_LEN);
+        if (!ha1_cache) {
+            LM_ERR("Failed to create HA1 cache\n");
+            return -1;
+        }
+    }
+    if (nc_cache_size > 0) {
+        nc_cache = web3_cache_new(nc_cache_size, sizeof(unsigned int));
+        if (!nc_cache) {
+            LM_ERR("Failed to create nonce-count cache\n");
+            return -1;
+        }
+    }
+    
+    // Connection bindings of flow-bound authentication
+    if (flow_ttl > 0) {
+        if (flow_table_size <= 0) {
+            LM_ERR("flow_table_size must be positive\n");
+            return -1;
+        }
+        flow_table = web3_flow_new(flow_table_size);
+        if (!flow_table) {
+            LM_ERR("Failed to create flow table\n");
+            return -1;
+        }
+    }
+    
     LM_INFO("Web3 Auth module initialized successfully\n");
     LM_INFO("Using RPC URL: %s\n", rpc_url);
     LM_INFO("Using contract address: %s\n", contract_address);
+    LM_INFO("Using %s SHA-256 kernel\n", web3_sha256_impl());
+    LM_INFO("Using %s hex kernel\n", web3_hex_impl());
     
     return 0;
 }
 
+// Refresh the RPC host addresses a tenth of the TTL before they expire
+static void dns_timer_exec(unsigned int ticks, void* param) {
+    unsigned int margin = dns_ttl / 10;
+    web3_dns_refresh((unsigned int)time(NULL), margin > 0 ? margin : 1);
+}
+
+// Post the spans queued by all workers to the collector
+static void trace_timer_exec(unsigned int ticks, void* param) {
+    web3_trace_export(trace_url, trace_service, rpc_url);
+}
+
+// Per-process initialization
+static int child_init(int rank) {
+    // Runs in the main process before forking, when the number of
+    // processes is final
+    if (rank == PROC_INIT) {
+        rpc_hist = web3_hist_set_new(get_max_procs(), RPC_PHASE_COUNT);
+        rpc_inflight = shm_malloc(get_max_procs() * sizeof(int));
+        if (!rpc_hist || !rpc_inflight) {
+            LM_ERR("Failed to allocate per-process RPC state\n");
+            return -1;
+        }
+        memset(rpc_inflight, 0, get_max_procs() * sizeof(int));
+        rpc_inflight_procs = get_max_procs();
+        if (tracing && web3_trace_init(get_max_procs(), trace_sample) < 0) {
+            LM_ERR("Failed to allocate span rings\n");
+            return -1;
+        }
+        if (profile && web3_prof_init(get_max_procs()) < 0) {
+            LM_ERR("Failed to allocate profiler slots\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (rank == PROC_MAIN && metrics_port > 0) {
+        int pid = fork_process(PROC_NOCHLDINIT, "WEB3 AUTH METRICS", 1);
+        if (pid < 0) {
+            LM_ERR("Failed to start metrics process\n");
+            return -1;
+        }
+        if (pid == 0) {
+            if (cfg_child_init()) return -1;
+            web3_metrics_serve(metrics_address, metrics_port, metrics_render);
+            exit(-1);
+        }
+    }
+    if (rank == PROC_MAIN && tracing) {
+        if (fork_basic_utimer(PROC_TIMER, "WEB3 AUTH TRACE", 1, trace_timer_exec, NULL,
+                TRACE_EXPORT_INTERVAL) < 0) {
+            LM_ERR("Failed to start span export timer process\n");
+            return -1;
+        }
+    }
+    if (rank == PROC_MAIN && dns_timer) {
+        if (fork_basic_timer(PROC_TIMER, "WEB3 AUTH DNS", 1, dns_timer_exec, NULL, 1) < 0) {
+            LM_ERR("Failed to start DNS timer process\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
 // Module cleanup function
 static void mod_destroy(void) {
     LM_INFO("Web3 Auth module destroying...\n");
+    web3_cache_destroy(ha1_cache);
+    web3_cache_destroy(nc_cache);
+    web3_flow_destroy(flow_table);
+    ha1_cache = NULL;
+    nc_cache = NULL;
+    flow_table = NULL;
+    web3_dns_destroy();
+    web3_hist_set_destroy(rpc_hist);
+    rpc_hist = NULL;
+    if (rpc_inflight) shm_free(rpc_inflight);
+    rpc_inflight = NULL;
+    web3_trace_destroy();
+    web3_prof_destroy();
+    web3_arena_destroy(&arena);
+    if (http_body) pkg_free(http_body);
+    http_body = NULL;
+    plan_free(&digest_plan);
+    plan_free(&ha1_plan);
+    contract_method_free(&digest_call);
+    for (int i = 0; i < DIGEST_ALG_COUNT; i++) {
+        contract_method_free(&ha1_calls[i]);
+    }
     curl_global_cleanup();
     LM_INFO("Web3 Auth module destroyed\n");
 }
@@ -536,15 +2398,267 @@ static void mod_destroy(void) {
 static param_export_t params[] = {
     {"rpc_url", PARAM_STRING, &rpc_url},
     {"contract_address", PARAM_STRING, &contract_address},
+    {"digest_method", PARAM_STRING, &digest_method},
+    {"digest_args", PARAM_STRING, &digest_args},
+    {"rpc_compression", PARAM_INT, &rpc_compression},
+    {"rpc_max_response", PARAM_INT, &rpc_max_response},
+    {"dns_ttl", PARAM_INT, &dns_ttl},
+    {"rpc_connect_timeout", PARAM_INT, &rpc_connect_timeout},
+    {"rpc_tls_timeout", PARAM_INT, &rpc_tls_timeout},
+    {"rpc_timeout", PARAM_INT, &rpc_timeout},
+    {"rpc_adaptive_timeout", PARAM_INT, &rpc_adaptive_timeout},
+    {"rpc_budget", PARAM_INT, &rpc_budget},
+    {"metrics_port", PARAM_INT, &metrics_port},
+    {"metrics_address", PARAM_STRING, &metrics_address},
+    {"trace_url", PARAM_STRING, &trace_url},
+    {"trace_ratio", PARAM_STRING, &trace_ratio},
+    {"trace_service", PARAM_STRING, &trace_service},
+    {"profile", PARAM_INT, &profile},
+    {"check_uri", PARAM_INT, &check_uri},
+    {"check_nonce", PARAM_INT, &check_nonce},
+    {"ha1_method", PARAM_STRING, &ha1_method},
+    {"ha1_sha256_method", PARAM_STRING, &ha1_sha256_method},
+    {"ha1_sha512_256_method", PARAM_STRING, &ha1_sha512_256_method},
+    {"ha1_args", PARAM_STRING, &ha1_args},
+    {"hashed_ids", PARAM_INT, &hashed_ids},
+    {"ha1_mode", PARAM_INT, &ha1_mode},
+    {"ha1_cache_size", PARAM_INT, &ha1_cache_size},
+    {"ha1_cache_ttl", PARAM_INT, &ha1_cache_ttl},
+    {"nc_cache_size", PARAM_INT, &nc_cache_size},
+    {"nonce_expire", PARAM_INT, &nonce_expire},
+    {"arena_size", PARAM_INT, &arena_size},
+    {"async_group", PARAM_STRING, &async_group},
+    {"flow_ttl", PARAM_INT, &flow_ttl},
+    {"flow_max_requests", PARAM_INT, &flow_max_requests},
+    {"flow_table_size", PARAM_INT, &flow_table_size},
     {0, 0, 0}
 };
 
+// Module statistics
+static stat_export_t mod_stats[] = {
+    {"malformed_credentials", 0, &stat_malformed},
+    {"unsupported_credentials", 0, &stat_unsupported},
+    {"uri_mismatch", 0, &stat_uri_mismatch},
+    {"ha1_cache_hits", 0, &stat_ha1_cache_hits},
+    {"ha1_cache_misses", 0, &stat_ha1_cache_misses},
+    {"nc_replays", 0, &stat_nc_replays},
+    {"stale_nonces", 0, &stat_stale_nonces},
+    {"flow_hits", 0, &stat_flow_hits},
+    {"rpc_timeouts", 0, &stat_rpc_timeouts},
+    {"rpc_abandoned", 0, &stat_rpc_abandoned},
+    {"auth_ok", 0, &stat_auth_ok},
+    {"auth_invalid_password", 0, &stat_auth_invalid_password},
+    {"auth_user_unknown", 0, &stat_auth_user_unknown},
+    {"auth_no_credentials", 0, &stat_auth_no_credentials},
+    {"auth_errors", 0, &stat_auth_errors},
+    {"rpc_dns_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_dns_avg},
+    {"rpc_connect_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_connect_avg},
+    {"rpc_tls_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_tls_avg},
+    {"rpc_server_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_server_avg},
+    {"rpc_transfer_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_transfer_avg},
+    {"rpc_total_avg_us", STAT_IS_FUNC, (stat_var**)stat_rpc_total_avg},
+    {"rpc_total_p50_us", STAT_IS_FUNC, (stat_var**)stat_rpc_total_p50},
+    {"rpc_total_p99_us", STAT_IS_FUNC, (stat_var**)stat_rpc_total_p99},
+    {"trace_dropped", STAT_IS_FUNC, (stat_var**)web3_trace_dropped},
+    {0, 0, 0}
+};
+
+// Module pseudo-variables
+static pv_export_t mod_pvs[] = {
+    {{"web3auth", sizeof("web3auth") - 1}, PVT_OTHER, pv_get_web3auth, 0,
+     pv_parse_web3auth_name, 0, 0, 0},
+    {{0, 0}, 0, 0, 0, 0, 0, 0, 0}
+};
+
+// KEMI wrappers; strings come in as str, results go out as ints or
+// native-typed values, without a pass through fixups or cfg params
+
+static int ki_web3_auth_check(struct sip_msg* msg) {
+    return web3_auth(msg, NULL);
+}
+
+static int ki_web3_auth_check_realm(struct sip_msg* msg, str* realm) {
+    if (realm->len <= 0) {
+        LM_ERR("Empty realm value\n");
+        return -1;
+    }
+    return web3_auth(msg, realm);
+}
+
+static int ki_web3_auth_http_request(struct sip_msg* msg) {
+    return web3_auth_http(msg, NULL);
+}
+
+static int ki_web3_auth_http_request_realm(struct sip_msg* msg, str* realm) {
+    if (realm->len <= 0) {
+        LM_ERR("Empty realm value\n");
+        return -1;
+    }
+    return web3_auth_http(msg, realm);
+}
+
+static int ki_web3_auth_http_response(struct sip_msg* msg, str* body) {
+    return web3_auth_http_result(msg, body, NULL);
+}
+
+static int ki_web3_auth_http_response_realm(struct sip_msg* msg, str* body, str* realm) {
+    if (realm->len <= 0) {
+        LM_ERR("Empty realm value\n");
+        return -1;
+    }
+    return web3_auth_http_result(msg, body, realm);
+}
+
+// Return code of the request's latest check, 0 when it had none
+static int ki_web3_auth_result(struct sip_msg* msg) {
+    if (async_resumed) return async_result;
+    return msg->id == last_result_msg ? last_result : 0;
+}
+
+// $web3auth(name) as an int (result), a string or null
+static sr_kemi_xval_t* ki_web3_auth_get(struct sip_msg* msg, str* name) {
+    static sr_kemi_xval_t xval;
+    pv_spec_t spec;
+    pv_value_t val;
+    
+    memset(&xval, 0, sizeof(xval));
+    memset(&spec, 0, sizeof(spec));
+    memset(&val, 0, sizeof(val));
+    xval.vtype = SR_KEMIP_NULL;
+    if (pv_parse_web3auth_name(&spec, name) < 0
+            || pv_get_web3auth(msg, &spec.pvp, &val) < 0 || (val.flags & PV_VAL_NULL)) {
+        return &xval;
+    }
+    if (val.flags & PV_VAL_INT) {
+        xval.vtype = SR_KEMIP_INT;
+        xval.v.n = (int)val.ri;
+    } else {
+        xval.vtype = SR_KEMIP_STR;
+        xval.v.s = val.rs;
+    }
+    return &xval;
+}
+
+// Drop every cached HA1
+static int ki_web3_auth_cache_flush(struct sip_msg* msg) {
+    if (!ha1_cache) return -1;
+    web3_cache_flush(ha1_cache);
+    return 1;
+}
+
+// Drop the cached HA1s of a user for all algorithms. The keys come from
+// ha1_args evaluated as for credentials with this username and realm
+static int ki_web3_auth_cache_remove(struct sip_msg* msg, str* username, str* realm) {
+    sip_auth_t auth = {0};
+    str values[WEB3_ABI_MAX_ARGS];
+    char buf[WEB3_ABI_MAX_ARGS][MAX_FIELD_SIZE];
+    char key_buf[WEB3_CACHE_KEY_SIZE];
+    str key;
+    int ret;
+    
+    if (!ha1_cache) return -1;
+    
+    auth.username = *username;
+    auth.realm = *realm;
+    current_auth = &auth;
+    ret = plan_eval(msg, &auth, &ha1_plan, values, buf);
+    current_auth = NULL;
+    if (ret != WEB3_AUTH_OK) return -1;
+    
+    for (int alg = 0; alg < DIGEST_ALG_COUNT; alg++) {
+        if (ha1_cache_key(alg, values, ha1_plan.nargs, key_buf, &key) == 0) {
+            web3_cache_remove(ha1_cache, &key);
+        }
+    }
+    return 1;
+}
+
+static int ki_web3_auth_flow_unbind(struct sip_msg* msg) {
+    return web3_auth_flow_unbind(msg, NULL, NULL);
+}
+
+// Functions exported to KEMI scripts as KSR.web3_auth.*
+static sr_kemi_t sr_kemi_web3_auth_exports[] = {
+    { str_init("web3_auth"), str_init("check"),
+        SR_KEMIP_INT, ki_web3_auth_check,
+        { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("check_realm"),
+        SR_KEMIP_INT, ki_web3_auth_check_realm,
+        { SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("http_request"),
+        SR_KEMIP_INT, ki_web3_auth_http_request,
+        { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("http_request_realm"),
+        SR_KEMIP_INT, ki_web3_auth_http_request_realm,
+        { SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("http_response"),
+        SR_KEMIP_INT, ki_web3_auth_http_response,
+        { SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("http_response_realm"),
+        SR_KEMIP_INT, ki_web3_auth_http_response_realm,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("result"),
+        SR_KEMIP_INT, ki_web3_auth_result,
+        { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("get"),
+        SR_KEMIP_XVAL, ki_web3_auth_get,
+        { SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("cache_flush"),
+        SR_KEMIP_INT, ki_web3_auth_cache_flush,
+        { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("cache_remove"),
+        SR_KEMIP_INT, ki_web3_auth_cache_remove,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { str_init("web3_auth"), str_init("flow_unbind"),
+        SR_KEMIP_INT, ki_web3_auth_flow_unbind,
+        { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+    { {0, 0}, {0, 0}, 0, NULL, { 0, 0, 0, 0, 0, 0 } }
+};
+
 // Module commands that can be called from kamailio.cfg
 static cmd_export_t cmds[] = {
     {"web3_auth_check", (cmd_function)web3_auth_check, 0, 0, 0, 
      REQUEST_ROUTE | FAILURE_ROUTE},
-    {"web3_auth_with_realm", (cmd_function)web3_auth_with_realm, 1, fixup_spve_null, 0,
+    {"web3_auth_with_realm", (cmd_function)web3_auth_with_realm, 1, fixup_spve_null,
+     fixup_free_spve_null,
      REQUEST_ROUTE | FAILURE_ROUTE},
+    {"web3_auth_check_async", (cmd_function)web3_auth_check_async, 1, fixup_auth_async, 0,
+     REQUEST_ROUTE | FAILURE_ROUTE},
+    {"web3_auth_with_realm_async", (cmd_function)web3_auth_with_realm_async, 2,
+     fixup_auth_realm_async, fixup_free_auth_realm_async,
+     REQUEST_ROUTE | FAILURE_ROUTE},
+    {"web3_auth_http_request", (cmd_function)web3_auth_http_request, 0, 0, 0,
+     REQUEST_ROUTE | FAILURE_ROUTE},
+    {"web3_auth_http_request", (cmd_function)web3_auth_http_request_realm, 1,
+     fixup_spve_null, fixup_free_spve_null,
+     REQUEST_ROUTE | FAILURE_ROUTE},
+    {"web3_auth_http_response", (cmd_function)web3_auth_http_response, 1,
+     fixup_spve_null, fixup_free_spve_null, ANY_ROUTE},
+    {"web3_auth_http_response", (cmd_function)web3_auth_http_response_realm, 2,
+     fixup_spve_spve, fixup_free_spve_spve, ANY_ROUTE},
+    {"web3_auth_flow_unbind", (cmd_function)web3_auth_flow_unbind, 0, 0, 0, ANY_ROUTE},
     {0, 0, 0, 0, 0, 0}
 };
 
@@ -554,12 +2668,18 @@ struct module_exports exports = {
     DEFAULT_DLFLAGS,    /* dlopen flags */
     cmds,               /* exported functions */
     params,             /* exported parameters */
-    0,                  /* exported statistics */
+    mod_stats,          /* exported statistics */
     0,                  /* exported MI functions */
-    0,                  /* exported pseudo-variables */
+    mod_pvs,            /* exported pseudo-variables */
     0,                  /* extra processes */
     mod_init,           /* module initialization function */
     0,                  /* response function */
     mod_destroy,        /* destroy function */
-    0                   /* child initialization function */
-}; 
\ No newline at end of file
+    child_init          /* child initialization function */
+}; 
+
+// Called when the module is loaded, before mod_init
+int mod_register(char* path, int* dlflags, void* p1, void* p2) {
+    sr_kemi_modules_add(sr_kemi_web3_auth_exports);
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared memory key/value cache with per-entry expiry
+ *
+ * The table is set associative: a key hashes to one set of
+ * WEB3_CACHE_WAYS entries and only that set is scanned. Sets are
+ * protected by a lock set, so workers only contend on the same set.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+
+#include "web3_cache.h"
+
+#define WEB3_CACHE_WAYS 4
+#define WEB3_CACHE_LOCKS 256
+
+typedef struct web3_cache_entry {
+    unsigned int hash;
+    unsigned int expires;   // 0 marks a free slot
+    unsigned short key_len;
+    char key[WEB3_CACHE_KEY_SIZE];
+    // followed by val_size bytes of value
+} web3_cache_entry_t;
+
+struct web3_cache {
+    unsigned int set_mask;
+    unsigned int lock_mask;
+    unsigned int val_size;
+    unsigned int entry_size;
+    gen_lock_set_t* locks;
+    char* entries;
+};
+
+// FNV-1a, good enough to spread keys over the sets
+static inline unsigned int cache_hash(const str* key) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < key->len; i++) {
+        h ^= (unsigned char)key->s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline web3_cache_entry_t* cache_entry(web3_cache_t* cache,
+        unsigned int set, int way) {
+    return (web3_cache_entry_t*)(cache->entries
+            + ((size_t)set * WEB3_CACHE_WAYS + way) * cache->entry_size);
+}
+
+static inline void* entry_val(web3_cache_entry_t* e) {
+    return (char*)e + sizeof(web3_cache_entry_t);
+}
+
+static inline int entry_matches(web3_cache_entry_t* e, unsigned int hash,
+        const str* key) {
+    return e->expires != 0 && e->hash == hash && e->key_len == key->len
+        && memcmp(e->key, key->s, key->len) == 0;
+}
+
+web3_cache_t* web3_cache_new(unsigned int size, unsigned int val_size) {
+    web3_cache_t* cache;
+    unsigned int sets = 1;
+    unsigned int nlocks;
+    size_t entry_size;
+
+    while (sets * WEB3_CACHE_WAYS < size) sets <<= 1;
+    nlocks = sets < WEB3_CACHE_LOCKS ? sets : WEB3_CACHE_LOCKS;
+
+    // keep entries 8 byte aligned
+    entry_size = (sizeof(web3_cache_entry_t) + val_size + 7) & ~(size_t)7;
+
+    cache = shm_malloc(sizeof(web3_cache_t));
+    if (!cache) {
+        SHM_MEM_ERROR;
+        return NULL;
+    }
+    memset(cache, 0, sizeof(web3_cache_t));
+
+    cache->set_mask = sets - 1;
+    cache->lock_mask = nlocks - 1;
+    cache->val_size = val_size;
+    cache->entry_size = entry_size;
+
+    cache->entries = shm_malloc(entry_size * sets * WEB3_CACHE_WAYS);
+    if (!cache->entries) {
+        SHM_MEM_ERROR;
+        goto error;
+    }
+    memset(cache->entries, 0, entry_size * sets * WEB3_CACHE_WAYS);
+
+    cache->locks = lock_set_alloc(nlocks);
+    if (!cache->locks || !lock_set_init(cache->locks)) {
+        LM_ERR("Failed to initialize cache locks\n");
+        if (cache->locks) lock_set_dealloc(cache->locks);
+        cache->locks = NULL;
+        goto error;
+    }
+
+    return cache;
+
+error:
+    if (cache->entries) shm_free(cache->entries);
+    shm_free(cache);
+    return NULL;
+}
+
+void web3_cache_destroy(web3_cache_t* cache) {
+    if (!cache) return;
+    if (cache->locks) {
+        lock_set_destroy(cache->locks);
+        lock_set_dealloc(cache->locks);
+    }
+    if (cache->entries) shm_free(cache->entries);
+    shm_free(cache);
+}
+
+int web3_cache_get(web3_cache_t* cache, const str* key, unsigned int now,
+        void* val) {
+    unsigned int hash, set;
+    web3_cache_entry_t* e;
+    int ret = -1;
+
+    if (!cache || key->len > WEB3_CACHE_KEY_SIZE) return -1;
+
+    hash = cache_hash(key);
+    set = hash & cache->set_mask;
+
+    lock_set_get(cache->locks, set & cache->lock_mask);
+    for (int way = 0; way < WEB3_CACHE_WAYS; way++) {
+        e = cache_entry(cache, set, way);
+        if (entry_matches(e, hash, key)) {
+            if (e->expires > now) {
+                memcpy(val, entry_val(e), cache->val_size);
+                ret = 0;
+            } else {
+                e->expires = 0;
+            }
+            break;
+        }
+    }
+    lock_set_release(cache->locks, set & cache->lock_mask);
+
+    return ret;
+}
+
+// Pick the slot for 'key' in its set: the matching entry, else a free or
+// expired one, else the entry closest to expiry. Called with the set locked
+static web3_cache_entry_t* cache_slot(web3_cache_t* cache, unsigned int set,
+        unsigned int hash, const str* key, unsigned int now, int* found) {
+    web3_cache_entry_t* e;
+    web3_cache_entry_t* victim = NULL;
+
+    *found = 0;
+    for (int way = 0; way < WEB3_CACHE_WAYS; way++) {
+        e = cache_entry(cache, set, way);
+        if (entry_matches(e, hash, key)) {
+            if (e->expires > now) *found = 1;
+            return e;
+        }
+        if (!victim || e->expires < victim->expires) victim = e;
+    }
+    return victim;
+}
+
+static inline void entry_set_key(web3_cache_entry_t* e, unsigned int hash,
+        const str* key) {
+    e->hash = hash;
+    e->key_len = key->len;
+    memcpy(e->key, key->s, key->len);
+}
+
+void web3_cache_put(web3_cache_t* cache, const str* key, unsigned int expires,
+        const void* val) {
+    unsigned int hash, set;
+    web3_cache_entry_t* e;
+    int found;
+
+    if (!cache || key->len > WEB3_CACHE_KEY_SIZE || expires == 0) return;
+
+    hash = cache_hash(key);
+    set = hash & cache->set_mask;
+
+    lock_set_get(cache->locks, set & cache->lock_mask);
+    e = cache_slot(cache, set, hash, key, 0, &found);
+    entry_set_key(e, hash, key);
+    e->expires = expires;
+    memcpy(entry_val(e), val, cache->val_size);
+    lock_set_release(cache->locks, set & cache->lock_mask);
+}
+
+void web3_cache_remove(web3_cache_t* cache, const str* key) {
+    unsigned int hash, set;
+    web3_cache_entry_t* e;
+
+    if (!cache || key->len > WEB3_CACHE_KEY_SIZE) return;
+
+    hash = cache_hash(key);
+    set = hash & cache->set_mask;
+
+    lock_set_get(cache->locks, set & cache->lock_mask);
+    for (int way = 0; way < WEB3_CACHE_WAYS; way++) {
+        e = cache_entry(cache, set, way);
+        if (entry_matches(e, hash, key)) {
+            e->expires = 0;
+            break;
+        }
+    }
+    lock_set_release(cache->locks, set & cache->lock_mask);
+}
+
+void web3_cache_flush(web3_cache_t* cache) {
+    if (!cache) return;
+
+    for (unsigned int set = 0; set <= cache->set_mask; set++) {
+        lock_set_get(cache->locks, set & cache->lock_mask);
+        for (int way = 0; way < WEB3_CACHE_WAYS; way++) {
+            cache_entry(cache, set, way)->expires = 0;
+        }
+        lock_set_release(cache->locks, set & cache->lock_mask);
+    }
+}
+
+int web3_cache_nc_check(web3_cache_t* cache, const str* key,
+        unsigned int nc, unsigned int now, unsigned int expires) {
+    unsigned int hash, set, last;
+    web3_cache_entry_t* e;
+    int found, ret = 1;
+
+    if (!cache || key->len > WEB3_CACHE_KEY_SIZE) return -1;
+
+    hash = cache_hash(key);
+    set = hash & cache->set_mask;
+
+    lock_set_get(cache->locks, set & cache->lock_mask);
+    e = cache_slot(cache, set, hash, key, now, &found);
+    if (found) {
+        memcpy(&last, entry_val(e), sizeof(last));
+        if (nc <= last) {
+            ret = 0;
+        } else {
+            memcpy(entry_val(e), &nc, sizeof(nc));
+        }
+    } else if (e->expires > now && !entry_matches(e, hash, key)) {
+        // Evicting a live nonce would let its requests be replayed
+        ret = -1;
+    } else {
+        entry_set_key(e, hash, key);
+        e->expires = expires;
+        memcpy(entry_val(e), &nc, sizeof(nc));
+    }
+    lock_set_release(cache->locks, set & cache->lock_mask);
+
+    return ret;
+}
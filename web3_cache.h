@@ -0,0 +1,42 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared memory key/value cache with per-entry expiry
+ *
+ * Used to keep HA1 values fetched from the contract and the last
+ * nonce-count seen for each nonce, so repeated authentications of the
+ * same user do not need a blockchain round trip.
+ */
+
+#ifndef _WEB3_CACHE_H_
+#define _WEB3_CACHE_H_
+
+#include "../../core/str.h"
+
+// Longest key an entry can hold; longer keys are never cached
+#define WEB3_CACHE_KEY_SIZE 128
+
+typedef struct web3_cache web3_cache_t;
+
+// Create a cache with at least 'size' entries holding 'val_size' bytes each
+web3_cache_t* web3_cache_new(unsigned int size, unsigned int val_size);
+void web3_cache_destroy(web3_cache_t* cache);
+
+// Copy the value of a live entry to 'val'; returns 0 on hit, -1 on miss
+int web3_cache_get(web3_cache_t* cache, const str* key, unsigned int now,
+        void* val);
+
+// Insert or replace an entry valid until 'expires'
+void web3_cache_put(web3_cache_t* cache, const str* key, unsigned int expires,
+        const void* val);
+
+void web3_cache_remove(web3_cache_t* cache, const str* key);
+void web3_cache_flush(web3_cache_t* cache);
+
+// Record nonce-count 'nc' for the nonce in 'key' if it is higher than the
+// last one seen, keeping the record until 'expires'; returns 1 when
+// accepted, 0 on replay, -1 if not cacheable or when the set has no room
+// without evicting a live nonce
+int web3_cache_nc_check(web3_cache_t* cache, const str* key,
+        unsigned int nc, unsigned int now, unsigned int expires);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared resolver cache for the RPC host
+ *
+ * One shm entry holds the addresses of the RPC host and a generation
+ * counter. Only the timer process calls getaddrinfo(); on failure the
+ * previous addresses stay in use until a later attempt succeeds. Each
+ * worker keeps the CURLOPT_RESOLVE list of the generation it saw last.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#include "../../core/dprint.h"
+#include "../../core/locking.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "web3_dns.h"
+
+#define DNS_HOST_SIZE 256
+#define DNS_ADDR_SIZE (INET6_ADDRSTRLEN + 2)   // IPv6 in brackets
+#define DNS_RETRY_INTERVAL 5
+
+typedef struct web3_dns_entry {
+    gen_lock_t lock;
+    char host[DNS_HOST_SIZE];
+    int port;
+    unsigned int ttl;
+    unsigned int expires;           // addresses are refreshed before this
+    unsigned int next_attempt;      // after a failed resolution
+    unsigned int generation;        // bumped whenever the addresses change
+    int naddrs;
+    char addrs[WEB3_DNS_MAX_ADDRS][DNS_ADDR_SIZE];
+} web3_dns_entry_t;
+
+static web3_dns_entry_t* dns_entry = NULL;
+
+// Per process: the resolve list and the generation it was built from
+static struct curl_slist* resolve_list = NULL;
+static unsigned int resolve_generation = 0;
+
+// Resolve 'host' into 'addrs'; returns the number of addresses, -1 on error
+static int dns_lookup(const char* host, char addrs[][DNS_ADDR_SIZE]) {
+    struct addrinfo hints, *res, *ai;
+    int n = 0;
+    int err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    err = getaddrinfo(host, NULL, &hints, &res);
+    if (err != 0) {
+        LM_WARN("Failed to resolve RPC host %s: %s\n", host, gai_strerror(err));
+        return -1;
+    }
+
+    for (ai = res; ai && n < WEB3_DNS_MAX_ADDRS; ai = ai->ai_next) {
+        char buf[INET6_ADDRSTRLEN];
+        int dup = 0;
+
+        if (ai->ai_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)ai->ai_addr)->sin_addr,
+                    buf, sizeof(buf));
+            snprintf(addrs[n], DNS_ADDR_SIZE, "%s", buf);
+        } else if (ai->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6*)ai->ai_addr)->sin6_addr,
+                    buf, sizeof(buf));
+            snprintf(addrs[n], DNS_ADDR_SIZE, "[%s]", buf);
+        } else {
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (strcmp(addrs[i], addrs[n]) == 0) dup = 1;
+        }
+        if (!dup) n++;
+    }
+    freeaddrinfo(res);
+
+    return n > 0 ? n : -1;
+}
+
+// Resolve the host and store the result; the lookup runs unlocked
+static void dns_update(unsigned int now) {
+    char addrs[WEB3_DNS_MAX_ADDRS][DNS_ADDR_SIZE];
+    int n = dns_lookup(dns_entry->host, addrs);
+    int changed;
+
+    lock_get(&dns_entry->lock);
+    if (n < 0) {
+        dns_entry->next_attempt = now + DNS_RETRY_INTERVAL;
+    } else {
+        // Only the strings count: the bytes after each NUL are garbage
+        changed = n != dns_entry->naddrs;
+        for (int i = 0; i < n && !changed; i++) {
+            changed = strcmp(addrs[i], dns_entry->addrs[i]) != 0;
+        }
+        if (changed) {
+            memcpy(dns_entry->addrs, addrs, n * DNS_ADDR_SIZE);
+            dns_entry->naddrs = n;
+            dns_entry->generation++;
+        }
+        dns_entry->expires = now + dns_entry->ttl;
+        dns_entry->next_attempt = 0;
+    }
+    lock_release(&dns_entry->lock);
+}
+
+int web3_dns_init(const char* url, unsigned int ttl) {
+    CURLU* u;
+    char* host = NULL;
+    char* port = NULL;
+    struct in_addr a4;
+    int ret = -1;
+
+    u = curl_url();
+    if (!u) return -1;
+    if (curl_url_set(u, CURLUPART_URL, url, 0) != CURLUE_OK
+            || curl_url_get(u, CURLUPART_HOST, &host, 0) != CURLUE_OK
+            || curl_url_get(u, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) != CURLUE_OK) {
+        LM_ERR("Cannot parse host of RPC URL %s\n", url);
+        goto done;
+    }
+
+    // IP literals need no resolving
+    if (host[0] == '[' || inet_pton(AF_INET, host, &a4) == 1) {
+        ret = 1;
+        goto done;
+    }
+    if (strlen(host) >= DNS_HOST_SIZE) {
+        LM_ERR("RPC host name too long: %s\n", host);
+        goto done;
+    }
+
+    dns_entry = shm_malloc(sizeof(web3_dns_entry_t));
+    if (!dns_entry) {
+        SHM_MEM_ERROR;
+        goto done;
+    }
+    memset(dns_entry, 0, sizeof(web3_dns_entry_t));
+    if (!lock_init(&dns_entry->lock)) {
+        LM_ERR("Failed to init DNS cache lock\n");
+        shm_free(dns_entry);
+        dns_entry = NULL;
+        goto done;
+    }
+    strcpy(dns_entry->host, host);
+    dns_entry->port = atoi(port);
+    dns_entry->ttl = ttl;
+
+    dns_update((unsigned int)time(NULL));
+    if (dns_entry->naddrs > 0) {
+        LM_INFO("RPC host %s resolved to %d address(es), first %s\n",
+                dns_entry->host, dns_entry->naddrs, dns_entry->addrs[0]);
+    }
+    ret = 0;
+
+done:
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(u);
+    return ret;
+}
+
+void web3_dns_destroy(void) {
+    if (resolve_list) {
+        curl_slist_free_all(resolve_list);
+        resolve_list = NULL;
+    }
+    if (dns_entry) {
+        lock_destroy(&dns_entry->lock);
+        shm_free(dns_entry);
+        dns_entry = NULL;
+    }
+}
+
+void web3_dns_refresh(unsigned int now, unsigned int margin) {
+    int due;
+
+    if (!dns_entry) return;
+
+    lock_get(&dns_entry->lock);
+    if (dns_entry->next_attempt) {
+        due = now >= dns_entry->next_attempt;
+    } else {
+        due = now + margin >= dns_entry->expires;
+    }
+    lock_release(&dns_entry->lock);
+
+    if (due) dns_update(now);
+}
+
+struct curl_slist* web3_dns_resolve_list(void) {
+    char buf[DNS_HOST_SIZE + 16 + WEB3_DNS_MAX_ADDRS * (DNS_ADDR_SIZE + 1)];
+    int len;
+
+    if (!dns_entry) return NULL;
+
+    // Cheap check first: the list only changes with the generation
+    lock_get(&dns_entry->lock);
+    if (dns_entry->generation == resolve_generation || dns_entry->naddrs == 0) {
+        lock_release(&dns_entry->lock);
+        return resolve_list;
+    }
+    len = snprintf(buf, sizeof(buf), "%s:%d:", dns_entry->host, dns_entry->port);
+    for (int i = 0; i < dns_entry->naddrs; i++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%s%s", i ? "," : "",
+                dns_entry->addrs[i]);
+    }
+    resolve_generation = dns_entry->generation;
+    lock_release(&dns_entry->lock);
+
+    if (resolve_list) curl_slist_free_all(resolve_list);
+    resolve_list = curl_slist_append(NULL, buf);
+    return resolve_list;
+}
@@ -0,0 +1,34 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared resolver cache for the RPC host
+ *
+ * The host of rpc_url is resolved at startup and then again in the
+ * background before its TTL runs out. Workers pin the cached addresses on
+ * their curl handles with CURLOPT_RESOLVE, so SIP request handling never
+ * waits on getaddrinfo().
+ */
+
+#ifndef _WEB3_DNS_H_
+#define _WEB3_DNS_H_
+
+#include <curl/curl.h>
+
+#define WEB3_DNS_MAX_ADDRS 8
+
+// Set up the shared entry for the host of 'url' and resolve it once.
+// Returns 0 on success, 1 if the host is an IP literal (nothing to cache),
+// -1 on error. A failed first resolution is not an error: it is retried
+// by web3_dns_refresh() and curl resolves by itself until then.
+int web3_dns_init(const char* url, unsigned int ttl);
+void web3_dns_destroy(void);
+
+// Resolve again if the addresses expire within 'margin' seconds or a
+// previous attempt failed; called from the timer process
+void web3_dns_refresh(unsigned int now, unsigned int margin);
+
+// CURLOPT_RESOLVE list pinning the cached addresses ("host:port:a,b"),
+// owned by this module and rebuilt only when the addresses changed; NULL
+// when nothing is cached
+struct curl_slist* web3_dns_resolve_list(void);
+
+#endif
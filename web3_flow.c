@@ -0,0 +1,162 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared memory table of identities bound to TCP/TLS/WS connections
+ *
+ * Connection ids are handed out sequentially by the TCP layer, so the
+ * low bits spread them evenly: a binding lives in the set of its id and
+ * only that set is scanned. Sets are protected by a lock set, as in
+ * web3_cache.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+
+#include "web3_flow.h"
+
+#define WEB3_FLOW_WAYS 4
+#define WEB3_FLOW_LOCKS 256
+
+typedef struct web3_flow_entry {
+    int id;
+    unsigned int expires;   // 0 marks a free slot
+    unsigned int remaining; // requests left
+    uint8_t user[WEB3_FLOW_IDENT_SIZE];
+    uint8_t realm[WEB3_FLOW_IDENT_SIZE];
+} web3_flow_entry_t;
+
+struct web3_flow_table {
+    unsigned int set_mask;
+    unsigned int lock_mask;
+    gen_lock_set_t* locks;
+    web3_flow_entry_t* entries;
+};
+
+static inline web3_flow_entry_t* flow_set(web3_flow_table_t* table, int id) {
+    return table->entries + ((unsigned int)id & table->set_mask) * WEB3_FLOW_WAYS;
+}
+
+static inline unsigned int flow_lock(web3_flow_table_t* table, int id) {
+    return (unsigned int)id & table->set_mask & table->lock_mask;
+}
+
+web3_flow_table_t* web3_flow_new(unsigned int size) {
+    web3_flow_table_t* table;
+    unsigned int sets = 1;
+    unsigned int nlocks;
+
+    while (sets * WEB3_FLOW_WAYS < size) sets <<= 1;
+    nlocks = sets < WEB3_FLOW_LOCKS ? sets : WEB3_FLOW_LOCKS;
+
+    table = shm_malloc(sizeof(web3_flow_table_t));
+    if (!table) {
+        SHM_MEM_ERROR;
+        return NULL;
+    }
+    memset(table, 0, sizeof(web3_flow_table_t));
+
+    table->set_mask = sets - 1;
+    table->lock_mask = nlocks - 1;
+
+    table->entries = shm_malloc(sizeof(web3_flow_entry_t) * sets * WEB3_FLOW_WAYS);
+    if (!table->entries) {
+        SHM_MEM_ERROR;
+        goto error;
+    }
+    memset(table->entries, 0, sizeof(web3_flow_entry_t) * sets * WEB3_FLOW_WAYS);
+
+    table->locks = lock_set_alloc(nlocks);
+    if (!table->locks || !lock_set_init(table->locks)) {
+        LM_ERR("Failed to initialize flow table locks\n");
+        if (table->locks) lock_set_dealloc(table->locks);
+        table->locks = NULL;
+        goto error;
+    }
+
+    return table;
+
+error:
+    if (table->entries) shm_free(table->entries);
+    shm_free(table);
+    return NULL;
+}
+
+void web3_flow_destroy(web3_flow_table_t* table) {
+    if (!table) return;
+    if (table->locks) {
+        lock_set_destroy(table->locks);
+        lock_set_dealloc(table->locks);
+    }
+    if (table->entries) shm_free(table->entries);
+    shm_free(table);
+}
+
+void web3_flow_bind(web3_flow_table_t* table, int id, const uint8_t* user,
+        const uint8_t* realm, unsigned int expires, unsigned int requests) {
+    web3_flow_entry_t* set;
+    web3_flow_entry_t* e = NULL;
+
+    if (!table || expires == 0 || requests == 0) return;
+
+    set = flow_set(table, id);
+    lock_set_get(table->locks, flow_lock(table, id));
+    // the connection's own slot, else the one closest to expiry
+    for (int way = 0; way < WEB3_FLOW_WAYS; way++) {
+        if (set[way].expires != 0 && set[way].id == id) {
+            e = &set[way];
+            break;
+        }
+        if (!e || set[way].expires < e->expires) e = &set[way];
+    }
+    e->id = id;
+    e->expires = expires;
+    e->remaining = requests;
+    memcpy(e->user, user, WEB3_FLOW_IDENT_SIZE);
+    memcpy(e->realm, realm, WEB3_FLOW_IDENT_SIZE);
+    lock_set_release(table->locks, flow_lock(table, id));
+}
+
+int web3_flow_take(web3_flow_table_t* table, int id, const uint8_t* user,
+        const uint8_t* realm, unsigned int now) {
+    web3_flow_entry_t* set;
+    web3_flow_entry_t* e;
+    int ret = 0;
+
+    if (!table) return 0;
+
+    set = flow_set(table, id);
+    lock_set_get(table->locks, flow_lock(table, id));
+    for (int way = 0; way < WEB3_FLOW_WAYS; way++) {
+        e = &set[way];
+        if (e->expires == 0 || e->id != id) continue;
+        if (e->expires <= now) {
+            e->expires = 0;
+        } else if (memcmp(e->user, user, WEB3_FLOW_IDENT_SIZE) == 0
+                && (!realm || memcmp(e->realm, realm, WEB3_FLOW_IDENT_SIZE) == 0)) {
+            ret = 1;
+            if (--e->remaining == 0) e->expires = 0;
+        }
+        break;
+    }
+    lock_set_release(table->locks, flow_lock(table, id));
+
+    return ret;
+}
+
+void web3_flow_unbind(web3_flow_table_t* table, int id) {
+    web3_flow_entry_t* set;
+
+    if (!table) return;
+
+    set = flow_set(table, id);
+    lock_set_get(table->locks, flow_lock(table, id));
+    for (int way = 0; way < WEB3_FLOW_WAYS; way++) {
+        if (set[way].expires != 0 && set[way].id == id) {
+            set[way].expires = 0;
+            break;
+        }
+    }
+    lock_set_release(table->locks, flow_lock(table, id));
+}
@@ -0,0 +1,39 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Shared memory table of identities bound to TCP/TLS/WS connections
+ *
+ * After a successful check on a connection-oriented transport the
+ * connection id is bound to the authenticated user and realm, so later
+ * requests of the same user on the same connection can skip verification
+ * for a limited time and number of requests.
+ */
+
+#ifndef _WEB3_FLOW_H_
+#define _WEB3_FLOW_H_
+
+#include <stdint.h>
+
+// Bytes of the user and realm digests kept per binding
+#define WEB3_FLOW_IDENT_SIZE 16
+
+typedef struct web3_flow_table web3_flow_table_t;
+
+// Create a table with at least 'size' bindings
+web3_flow_table_t* web3_flow_new(unsigned int size);
+void web3_flow_destroy(web3_flow_table_t* table);
+
+// Bind connection 'id' to user 'user' in realm 'realm' (digests) for
+// 'requests' requests until 'expires'; replaces any binding of the
+// connection
+void web3_flow_bind(web3_flow_table_t* table, int id, const uint8_t* user,
+        const uint8_t* realm, unsigned int expires, unsigned int requests);
+
+// Use one request of the binding of connection 'id', if it is live and
+// bound to 'user' in 'realm' ('realm' NULL for the bound realm); returns
+// 1 when the request is covered, else 0
+int web3_flow_take(web3_flow_table_t* table, int id, const uint8_t* user,
+        const uint8_t* realm, unsigned int now);
+
+void web3_flow_unbind(web3_flow_table_t* table, int id);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Hex encoding and validating decoding
+ *
+ * The vector kernels split bytes into nibbles and map them to chars with
+ * a pshufb table lookup; decoding classifies chars with compares, turns
+ * them into nibbles and merges pairs with pmaddubsw. Tails shorter than
+ * a vector are done by the scalar code.
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WEB3_HEX_X86 1
+#endif
+
+#include "web3_hex.h"
+
+static const char hex_digits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+};
+
+// Nibble value of each char ored with 0x10, 0 for non hex chars
+static const uint8_t hex_values[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+    ['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+    ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f
+};
+
+static void hex_encode_generic(const uint8_t* in, size_t len, char* out) {
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = hex_digits[in[i] >> 4];
+        out[i * 2 + 1] = hex_digits[in[i] & 0x0f];
+    }
+}
+
+// A char whose table entry lacks the 0x10 marker is not a hex digit
+static int hex_decode_generic(const char* in, size_t len, uint8_t* out) {
+    uint8_t bad = 0;
+
+    for (size_t i = 0; i < len; i += 2) {
+        uint8_t hi = hex_values[(uint8_t)in[i]];
+        uint8_t lo = hex_values[(uint8_t)in[i + 1]];
+        bad |= (uint8_t)~hi | (uint8_t)~lo;
+        out[i / 2] = (uint8_t)((hi << 4) | (lo & 0x0f));
+    }
+
+    return (bad & 0x10) ? -1 : 0;
+}
+
+#ifdef WEB3_HEX_X86
+__attribute__((target("sse4.1")))
+static void hex_encode_sse41(const uint8_t* in, size_t len, char* out) {
+    const __m128i table = _mm_loadu_si128((const __m128i*)hex_digits);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i lo = _mm_shuffle_epi8(table, _mm_and_si128(v, nibble));
+        _mm_storeu_si128((__m128i*)(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    hex_encode_generic(in + i, len - i, out + i * 2);
+}
+
+// Nibble values of 16 hex chars; sets *bad if any char is not hex
+__attribute__((target("sse4.1")))
+static inline __m128i hex_nibbles_sse41(__m128i c, int* bad) {
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+            _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+            _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lower));
+
+    if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff) *bad = 1;
+
+    return _mm_blendv_epi8(_mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)),
+            _mm_sub_epi8(c, _mm_set1_epi8('0')), digit);
+}
+
+__attribute__((target("sse4.1")))
+static int hex_decode_sse41(const char* in, size_t len, uint8_t* out) {
+    const __m128i merge = _mm_set1_epi16(0x0110);  // hi * 16 + lo
+    int bad = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m128i a = hex_nibbles_sse41(_mm_loadu_si128((const __m128i*)(in + i)), &bad);
+        __m128i b = hex_nibbles_sse41(_mm_loadu_si128((const __m128i*)(in + i + 16)), &bad);
+        a = _mm_maddubs_epi16(a, merge);
+        b = _mm_maddubs_epi16(b, merge);
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(a, b));
+    }
+
+    if (hex_decode_generic(in + i, len - i, out + i / 2) < 0) bad = 1;
+    return bad ? -1 : 0;
+}
+
+__attribute__((target("avx2")))
+static void hex_encode_avx2(const uint8_t* in, size_t len, char* out) {
+    const __m256i table = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)hex_digits));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+        // unpack works per 128 bit lane: bytes 0-7/16-23 and 8-15/24-31
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(out + i * 2), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + i * 2 + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    hex_encode_sse41(in + i, len - i, out + i * 2);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_nibbles_avx2(__m256i c, int* bad) {
+    __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+
+    if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1) *bad = 1;
+
+    return _mm256_blendv_epi8(_mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)),
+            _mm256_sub_epi8(c, _mm256_set1_epi8('0')), digit);
+}
+
+__attribute__((target("avx2")))
+static int hex_decode_avx2(const char* in, size_t len, uint8_t* out) {
+    const __m256i merge = _mm256_set1_epi16(0x0110);
+    int bad = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i*)(in + i)), &bad);
+        __m256i b = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i*)(in + i + 32)), &bad);
+        a = _mm256_maddubs_epi16(a, merge);
+        b = _mm256_maddubs_epi16(b, merge);
+        // packus works per lane; restore byte order across lanes
+        _mm256_storeu_si256((__m256i*)(out + i / 2),
+                _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8));
+    }
+
+    if (hex_decode_sse41(in + i, len - i, out + i / 2) < 0) bad = 1;
+    return bad ? -1 : 0;
+}
+#endif
+
+typedef void (*hex_encode_f)(const uint8_t* in, size_t len, char* out);
+typedef int (*hex_decode_f)(const char* in, size_t len, uint8_t* out);
+
+static hex_encode_f hex_encode = NULL;
+static hex_decode_f hex_decode = NULL;
+static const char* hex_impl_name = "generic";
+
+static inline void hex_select(void) {
+    if (hex_encode) return;
+#ifdef WEB3_HEX_X86
+    if (__builtin_cpu_supports("avx2")) {
+        hex_impl_name = "avx2";
+        hex_decode = hex_decode_avx2;
+        hex_encode = hex_encode_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        hex_impl_name = "sse4.1";
+        hex_decode = hex_decode_sse41;
+        hex_encode = hex_encode_sse41;
+        return;
+    }
+#endif
+    hex_decode = hex_decode_generic;
+    hex_encode = hex_encode_generic;
+}
+
+const char* web3_hex_impl(void) {
+    hex_select();
+    return hex_impl_name;
+}
+
+void web3_hex_encode(const uint8_t* in, size_t len, char* out) {
+    // selectors and other short inputs stay on the scalar code
+    if (len < 16) {
+        hex_encode_generic(in, len, out);
+        return;
+    }
+    hex_select();
+    hex_encode(in, len, out);
+}
+
+int web3_hex_decode(const char* in, size_t len, uint8_t* out) {
+    if (len & 1) return -1;
+    if (len < 32) return hex_decode_generic(in, len, out);
+    hex_select();
+    return hex_decode(in, len, out);
+}
@@ -0,0 +1,26 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Hex encoding and validating decoding
+ *
+ * Used by the ABI encoder, the JSON-RPC result handling and the digest
+ * comparison. Long inputs go through SSE4.1 or AVX2 kernels picked at
+ * runtime, with a table driven scalar fallback.
+ */
+
+#ifndef _WEB3_HEX_H_
+#define _WEB3_HEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Write 2 * len lower case hex chars (no terminating zero)
+void web3_hex_encode(const uint8_t* in, size_t len, char* out);
+
+// Decode 'len' hex chars (either case) into len / 2 bytes; returns 0 on
+// success, -1 if len is odd or a char is not a hex digit
+int web3_hex_decode(const char* in, size_t len, uint8_t* out);
+
+// Name of the kernel in use ("avx2", "sse4.1" or "generic")
+const char* web3_hex_impl(void);
+
+#endif
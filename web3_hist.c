@@ -0,0 +1,108 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Per-process log-linear histograms in shared memory
+ *
+ * Writers are single threaded processes updating their own slots with
+ * plain 64 bit stores, which are not torn on the platforms Kamailio runs
+ * on; a reader may see one value counted in 'total' but not yet in its
+ * bucket, which is harmless for monitoring.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "web3_hist.h"
+
+struct web3_hist_set {
+    int nprocs;
+    int nhist;
+    web3_hist_t hists[];    // nprocs * nhist, grouped by process
+};
+
+static inline int hist_bucket(uint64_t v) {
+    int msb;
+
+    if (v < 16) return (int)v;
+    msb = 63 - __builtin_clzll(v);
+    if (msb >= WEB3_HIST_OCTAVES) return WEB3_HIST_BUCKETS - 1;
+    return 16 + (msb - 4) * 8 + (int)((v >> (msb - 3)) & 7);
+}
+
+uint64_t web3_hist_bucket_lower(int b) {
+    int msb;
+
+    if (b < 16) return (uint64_t)b;
+    msb = (b - 16) / 8 + 4;
+    return (uint64_t)(8 + (b - 16) % 8) << (msb - 3);
+}
+
+web3_hist_set_t* web3_hist_set_new(int nprocs, int nhist) {
+    size_t size = sizeof(web3_hist_set_t) + (size_t)nprocs * nhist * sizeof(web3_hist_t);
+    web3_hist_set_t* set;
+
+    if (nprocs <= 0 || nhist <= 0) return NULL;
+
+    set = shm_malloc(size);
+    if (!set) {
+        SHM_MEM_ERROR;
+        return NULL;
+    }
+    memset(set, 0, size);
+    set->nprocs = nprocs;
+    set->nhist = nhist;
+    return set;
+}
+
+void web3_hist_set_destroy(web3_hist_set_t* set) {
+    if (set) shm_free(set);
+}
+
+web3_hist_t* web3_hist_get(web3_hist_set_t* set, int proc, int idx) {
+    if (!set || proc < 0 || proc >= set->nprocs || idx < 0 || idx >= set->nhist) {
+        return NULL;
+    }
+    return &set->hists[proc * set->nhist + idx];
+}
+
+void web3_hist_record(web3_hist_t* h, uint64_t v) {
+    h->count[hist_bucket(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+}
+
+void web3_hist_merge(web3_hist_set_t* set, int idx, web3_hist_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (!set || idx < 0 || idx >= set->nhist) return;
+
+    for (int p = 0; p < set->nprocs; p++) {
+        const web3_hist_t* h = &set->hists[p * set->nhist + idx];
+        if (h->total == 0) continue;
+        for (int b = 0; b < WEB3_HIST_BUCKETS; b++) {
+            out->count[b] += h->count[b];
+        }
+        out->total += h->total;
+        out->sum += h->sum;
+        if (h->max > out->max) out->max = h->max;
+    }
+}
+
+uint64_t web3_hist_quantile(const web3_hist_t* h, double q) {
+    uint64_t rank, seen = 0;
+
+    if (h->total == 0) return 0;
+    rank = (uint64_t)(q * (double)h->total);
+    if (rank >= h->total) rank = h->total - 1;
+
+    for (int b = 0; b < WEB3_HIST_BUCKETS; b++) {
+        seen += h->count[b];
+        if (seen > rank) {
+            uint64_t upper = b + 1 < WEB3_HIST_BUCKETS
+                ? web3_hist_bucket_lower(b + 1) - 1 : h->max;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
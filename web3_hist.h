@@ -0,0 +1,47 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Per-process log-linear histograms in shared memory
+ *
+ * Values below 16 get a bucket each; above, every power of two is split
+ * into 8 buckets, so a bucket is at most 12.5% wide (HDR histogram style
+ * with 3 significant bits). Each process writes only its own histograms,
+ * without locks; readers merge all processes.
+ */
+
+#ifndef _WEB3_HIST_H_
+#define _WEB3_HIST_H_
+
+#include <stdint.h>
+
+#define WEB3_HIST_OCTAVES 36
+#define WEB3_HIST_BUCKETS (16 + (WEB3_HIST_OCTAVES - 4) * 8)
+
+typedef struct web3_hist {
+    uint64_t count[WEB3_HIST_BUCKETS];
+    uint64_t total;         // number of values
+    uint64_t sum;
+    uint64_t max;
+} web3_hist_t;
+
+typedef struct web3_hist_set web3_hist_set_t;
+
+// Allocate 'nhist' histograms for each of 'nprocs' processes
+web3_hist_set_t* web3_hist_set_new(int nprocs, int nhist);
+void web3_hist_set_destroy(web3_hist_set_t* set);
+
+// Histogram 'idx' of process 'proc', NULL if out of range
+web3_hist_t* web3_hist_get(web3_hist_set_t* set, int proc, int idx);
+
+void web3_hist_record(web3_hist_t* h, uint64_t v);
+
+// Sum histogram 'idx' of all processes into 'out'
+void web3_hist_merge(web3_hist_set_t* set, int idx, web3_hist_t* out);
+
+// Value at quantile q (0..1): upper bound of the bucket holding it,
+// capped at the largest value seen
+uint64_t web3_hist_quantile(const web3_hist_t* h, double q);
+
+// Smallest value falling into bucket 'b'
+uint64_t web3_hist_bucket_lower(int b);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Locating the "result" string of a JSON-RPC response
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "web3_json.h"
+
+#define RESULT_PATTERN "\"result\":\""
+#define RESULT_PATTERN_LEN (sizeof(RESULT_PATTERN) - 1)
+
+int web3_json_result(const char* json, size_t len, const char** value,
+        size_t* value_len) {
+    const char* start = memmem(json, len, RESULT_PATTERN, RESULT_PATTERN_LEN);
+    const char* end;
+
+    if (!start) return -1;
+    start += RESULT_PATTERN_LEN;
+    end = memchr(start, '"', json + len - start);
+    if (!end) return -1;
+
+    *value = start;
+    *value_len = end - start;
+    return 0;
+}
+
+int web3_json_result_scan(const char* json, size_t old_len, size_t len,
+        size_t* result_pos) {
+    size_t from;
+
+    // Only the new data, plus a pattern length of overlap, is scanned
+    if (!*result_pos) {
+        const char* start;
+        from = old_len > RESULT_PATTERN_LEN ? old_len - RESULT_PATTERN_LEN : 0;
+        start = memmem(json + from, len - from, RESULT_PATTERN, RESULT_PATTERN_LEN);
+        if (!start) return 0;
+        *result_pos = start - json + RESULT_PATTERN_LEN;
+    }
+    from = old_len > *result_pos ? old_len : *result_pos;
+    return memchr(json + from, '"', len - from) != NULL;
+}
@@ -0,0 +1,27 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Locating the "result" string of a JSON-RPC response
+ *
+ * Not a JSON parser: the value is the text between "result":" and the
+ * next double quote, which is all a hex encoded eth_call result needs.
+ * Buffers are taken with their length and may contain NUL bytes.
+ */
+
+#ifndef _WEB3_JSON_H_
+#define _WEB3_JSON_H_
+
+#include <stddef.h>
+
+// Find the result value in 'json'; sets 'value' and 'value_len' and
+// returns 0, or -1 when there is no complete result string
+int web3_json_result(const char* json, size_t len, const char** value,
+        size_t* value_len);
+
+// Incremental form of web3_json_result() for a body received in chunks:
+// 'len' bytes are buffered, of which the first 'old_len' were already
+// scanned. 'result_pos' is the offset of the value, 0 until found, and is
+// kept between calls. Returns 1 once the value is complete, 0 otherwise
+int web3_json_result_scan(const char* json, size_t old_len, size_t len,
+        size_t* result_pos);
+
+#endif
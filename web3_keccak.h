@@ -0,0 +1,15 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Keccak-256 as used by Ethereum (original Keccak padding, not SHA3-256)
+ */
+
+#ifndef _WEB3_KECCAK_H_
+#define _WEB3_KECCAK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keccak-256 hash function
+void keccak256(const uint8_t *input, size_t input_len, uint8_t output[32]);
+
+#endif
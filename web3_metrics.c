@@ -0,0 +1,160 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Prometheus text exposition over HTTP
+ *
+ * Connections are handled one at a time: a scrape is a few kB rendered
+ * from memory, and the process serves nothing else. Slow clients are cut
+ * off by socket timeouts.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+
+#include "web3_metrics.h"
+
+#define METRICS_PAGE_SIZE 65536
+#define METRICS_REQUEST_SIZE 2048
+#define METRICS_IO_TIMEOUT 2
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+void web3_metrics_printf(web3_metrics_buf_t* out, const char* fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (out->len >= out->size) return;
+
+    va_start(ap, fmt);
+    n = vsnprintf(out->s + out->len, out->size - out->len, fmt, ap);
+    va_end(ap);
+
+    out->len = (n < 0) ? out->size + 1 : out->len + n;
+}
+
+static int write_all(int fd, const char* buf, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Read the request head; only the request line is looked at
+static int read_request(int fd, char* buf, int size) {
+    int len = 0;
+
+    while (len < size - 1) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += n;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) break;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static void handle_connection(int fd, web3_metrics_buf_t* page, web3_metrics_render_f render) {
+    char request[METRICS_REQUEST_SIZE];
+    char head[256];
+    const char* status = "200 OK";
+    const char* body;
+    int body_len, head_len;
+
+    if (read_request(fd, request, sizeof(request)) <= 0) return;
+
+    if (strncmp(request, "GET /metrics ", 13) == 0
+            || strncmp(request, "GET /metrics?", 13) == 0) {
+        page->len = 0;
+        render(page);
+        if (page->len > page->size) {
+            LM_ERR("Metrics page larger than %d bytes\n", page->size);
+            status = "500 Internal Server Error";
+            body = "page too large\n";
+            body_len = strlen(body);
+        } else {
+            body = page->s;
+            body_len = page->len;
+        }
+    } else {
+        status = "404 Not Found";
+        body = "only /metrics is served\n";
+        body_len = strlen(body);
+    }
+
+    head_len = snprintf(head, sizeof(head),
+            "HTTP/1.0 %s\r\nContent-Type: " METRICS_CONTENT_TYPE "\r\n"
+            "Content-Length: %d\r\nConnection: close\r\n\r\n", status, body_len);
+    if (write_all(fd, head, head_len) == 0) {
+        write_all(fd, body, body_len);
+    }
+}
+
+int web3_metrics_serve(const char* address, int port, web3_metrics_render_f render) {
+    struct sockaddr_in addr;
+    struct timeval tv = {METRICS_IO_TIMEOUT, 0};
+    web3_metrics_buf_t page;
+    int on = 1;
+    int sock;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        LM_ERR("Invalid metrics address: %s\n", address);
+        return -1;
+    }
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        LM_ERR("Cannot create metrics socket: %s\n", strerror(errno));
+        return -1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(sock, 16) < 0) {
+        LM_ERR("Cannot listen for metrics on %s:%d: %s\n", address, port, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    page.s = pkg_malloc(METRICS_PAGE_SIZE);
+    if (!page.s) {
+        PKG_MEM_ERROR;
+        close(sock);
+        return -1;
+    }
+    page.size = METRICS_PAGE_SIZE;
+
+    LM_INFO("Serving metrics on http://%s:%d/metrics\n", address, port);
+
+    for (;;) {
+        int fd = accept(sock, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) LM_WARN("Metrics accept failed: %s\n", strerror(errno));
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        handle_connection(fd, &page, render);
+        close(fd);
+    }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Prometheus text exposition over HTTP
+ *
+ * A minimal HTTP/1.0 server for GET /metrics, run in its own module
+ * process. The page is produced by a render callback that only reads
+ * per-process counters, so SIP workers are never waited on.
+ */
+
+#ifndef _WEB3_METRICS_H_
+#define _WEB3_METRICS_H_
+
+// Output buffer of the render callback
+typedef struct web3_metrics_buf {
+    char* s;
+    int size;
+    int len;                // > size once the page did not fit
+} web3_metrics_buf_t;
+
+typedef void (*web3_metrics_render_f)(web3_metrics_buf_t* out);
+
+// Append formatted text to the page
+void web3_metrics_printf(web3_metrics_buf_t* out, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Serve metrics on address:port until the process exits; returns -1 only
+// if the listening socket cannot be set up
+int web3_metrics_serve(const char* address, int port, web3_metrics_render_f render);
+
+#endif
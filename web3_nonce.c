@@ -0,0 +1,55 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Freshness of the nonces issued by the auth module's challenges
+ */
+
+#include <stdint.h>
+
+#include "web3_nonce.h"
+
+// Expiry, creation time and the first MD5 of the shortest nonce
+#define NONCE_BIN_MIN 24
+// Longest nonce: both MDs plus the nonce-count index and flags
+#define NONCE_BIN_MAX 45
+
+static int b64val(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+int web3_nonce_expires(const char* nonce, size_t len, unsigned int* expires) {
+    uint8_t bin[NONCE_BIN_MAX];
+    uint32_t acc = 0;
+    size_t n = 0;
+    int bits = 0;
+    int v;
+
+    while (len > 0 && nonce[len - 1] == '=') len--;
+    if (len > (NONCE_BIN_MAX * 4 + 2) / 3) return -1;
+
+    for (size_t i = 0; i < len; i++) {
+        v = b64val((unsigned char)nonce[i]);
+        if (v < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bin[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    if (n < NONCE_BIN_MIN) return -1;
+
+    *expires = ((uint32_t)bin[0] << 24) | ((uint32_t)bin[1] << 16)
+        | ((uint32_t)bin[2] << 8) | bin[3];
+    return 0;
+}
+
+int web3_nonce_check(const char* nonce, size_t len, unsigned int now,
+        unsigned int max_lifetime, unsigned int* expires) {
+    if (web3_nonce_expires(nonce, len, expires) < 0) return -1;
+    return *expires > now && *expires - now <= max_lifetime;
+}
@@ -0,0 +1,27 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Freshness of the nonces issued by the auth module's challenges
+ *
+ * An auth module nonce is the base64 of a binary block starting with its
+ * expiry and creation times (32 bit, network order), followed by MACs
+ * over them. The MACs need the auth module's secret and are not checked
+ * here: the nonce is part of the digest response, so a captured request
+ * cannot be replayed with another expiry.
+ */
+
+#ifndef _WEB3_NONCE_H_
+#define _WEB3_NONCE_H_
+
+#include <stddef.h>
+
+// Expiry time of 'nonce'; returns 0, or -1 when it is not an auth module
+// nonce
+int web3_nonce_expires(const char* nonce, size_t len, unsigned int* expires);
+
+// Whether 'nonce' is still valid at 'now' and does not claim to be valid
+// for more than 'max_lifetime' seconds: returns 1 with its expiry in
+// 'expires', 0 when stale, -1 when it is not an auth module nonce
+int web3_nonce_check(const char* nonce, size_t len, unsigned int now,
+        unsigned int max_lifetime, unsigned int* expires);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Cycle-counting stage profiler
+ *
+ * A timer costs two tick reads and a few additions. Open timers live on a
+ * small per-process stack, so a stage nested in another is charged to
+ * both the parent's total and its own self time only once.
+ */
+
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../../core/dprint.h"
+#include "../../core/pt.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "web3_prof.h"
+
+#define PROF_STACK_DEPTH 8
+#define PROF_CALIBRATION_NS 10000000
+
+static web3_prof_t* prof_procs = NULL;
+static int prof_nprocs = 0;
+static double prof_tick_rate = 1000.0;
+
+// Per process: open timers
+static struct {
+    uint8_t stage;
+    uint64_t start;
+    uint64_t child_ticks;
+} prof_stack[PROF_STACK_DEPTH];
+static int prof_depth = 0;
+
+static inline uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t prof_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return mono_ns();
+#endif
+}
+
+// Ticks per us, measured against the monotonic clock
+static double prof_calibrate(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    struct timespec pause = {0, PROF_CALIBRATION_NS};
+    uint64_t ns0, ns1, t0, t1;
+
+    ns0 = mono_ns();
+    t0 = prof_ticks();
+    nanosleep(&pause, NULL);
+    ns1 = mono_ns();
+    t1 = prof_ticks();
+    if (ns1 > ns0 && t1 > t0) {
+        return (double)(t1 - t0) * 1000.0 / (double)(ns1 - ns0);
+    }
+#endif
+    return 1000.0;
+}
+
+int web3_prof_init(int nprocs) {
+    size_t size = (size_t)nprocs * sizeof(web3_prof_t);
+
+    if (nprocs <= 0) return -1;
+
+    prof_procs = shm_malloc(size);
+    if (!prof_procs) {
+        SHM_MEM_ERROR;
+        return -1;
+    }
+    memset(prof_procs, 0, size);
+    prof_nprocs = nprocs;
+    prof_tick_rate = prof_calibrate();
+    LM_INFO("Profiling stages at %.0f ticks per us\n", prof_tick_rate);
+    return 0;
+}
+
+void web3_prof_destroy(void) {
+    if (prof_procs) {
+        shm_free(prof_procs);
+        prof_procs = NULL;
+    }
+}
+
+void web3_prof_enter(web3_stage_t stage) {
+    if (!prof_procs || process_no < 0 || process_no >= prof_nprocs) return;
+
+    // Too deep: not timed, the matching exit finds nothing to close
+    if (prof_depth == PROF_STACK_DEPTH) return;
+
+    prof_stack[prof_depth].stage = (uint8_t)stage;
+    prof_stack[prof_depth].child_ticks = 0;
+    prof_stack[prof_depth].start = prof_ticks();
+    prof_depth++;
+}
+
+void web3_prof_exit(web3_stage_t stage) {
+    uint64_t now;
+    int d;
+
+    if (!prof_procs) return;
+
+    for (d = prof_depth - 1; d >= 0 && prof_stack[d].stage != stage; d--);
+    if (d < 0) return;
+
+    now = prof_ticks();
+    while (prof_depth > d) {
+        int top = --prof_depth;
+        uint64_t ticks = now - prof_stack[top].start;
+        int parent = top > 0 ? prof_stack[top - 1].stage : WEB3_PROF_ROOT;
+        web3_prof_cell_t* cell = &prof_procs[process_no].cells[parent][prof_stack[top].stage];
+
+        cell->calls++;
+        cell->ticks += ticks;
+        cell->self_ticks += ticks > prof_stack[top].child_ticks
+                ? ticks - prof_stack[top].child_ticks : 0;
+        if (top > 0) prof_stack[top - 1].child_ticks += ticks;
+    }
+}
+
+int web3_prof_merge(web3_prof_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (!prof_procs) return -1;
+
+    for (int p = 0; p < prof_nprocs; p++) {
+        for (int i = 0; i <= WEB3_STAGE_COUNT; i++) {
+            for (int j = 0; j < WEB3_STAGE_COUNT; j++) {
+                const web3_prof_cell_t* c = &prof_procs[p].cells[i][j];
+                if (c->calls == 0) continue;
+                out->cells[i][j].calls += c->calls;
+                out->cells[i][j].ticks += c->ticks;
+                out->cells[i][j].self_ticks += c->self_ticks;
+            }
+        }
+    }
+    return 0;
+}
+
+double web3_prof_tick_rate(void) {
+    return prof_tick_rate;
+}
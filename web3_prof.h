@@ -0,0 +1,47 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Cycle-counting stage profiler
+ *
+ * Scoped timers around the stages of a check, read with rdtsc (the
+ * monotonic clock elsewhere). Each process accumulates calls, total and
+ * self time per (parent stage, stage) pair into its own shared memory
+ * slot, without locks; readers merge all processes into a call tree.
+ */
+
+#ifndef _WEB3_PROF_H_
+#define _WEB3_PROF_H_
+
+#include <stdint.h>
+
+#include "web3_stage.h"
+
+// Parent "stage" of the outermost timers
+#define WEB3_PROF_ROOT WEB3_STAGE_COUNT
+
+typedef struct web3_prof_cell {
+    uint64_t calls;
+    uint64_t ticks;         // from entry to exit
+    uint64_t self_ticks;    // minus the nested timers
+} web3_prof_cell_t;
+
+typedef struct web3_prof {
+    web3_prof_cell_t cells[WEB3_STAGE_COUNT + 1][WEB3_STAGE_COUNT];
+} web3_prof_t;
+
+// Allocate the slots of 'nprocs' processes and calibrate the tick rate.
+// Must run before forking; without it the timers do nothing.
+int web3_prof_init(int nprocs);
+void web3_prof_destroy(void);
+
+void web3_prof_enter(web3_stage_t stage);
+
+// Close the innermost timer of 'stage', and any left open inside it
+void web3_prof_exit(web3_stage_t stage);
+
+// Sum the slots of all processes into 'out'; returns -1 if not profiling
+int web3_prof_merge(web3_prof_t* out);
+
+// Ticks per microsecond
+double web3_prof_tick_rate(void);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * SHA-256 and SHA-512/256 for RFC 7616 digest algorithms
+ *
+ * SHA-256 blocks are processed with the x86 SHA extensions when the CPU
+ * has them, selected at runtime; otherwise portable C is used.
+ */
+
+#ifndef _WEB3_SHA2_H_
+#define _WEB3_SHA2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WEB3_SHA256_LEN 32
+#define WEB3_SHA512_256_LEN 32
+
+typedef struct web3_sha256_ctx {
+    uint32_t state[8];
+    uint64_t count;         // bytes processed
+    uint8_t buf[64];
+} web3_sha256_ctx_t;
+
+typedef struct web3_sha512_ctx {
+    uint64_t state[8];
+    uint64_t count;         // bytes processed (inputs are far below 2^64)
+    uint8_t buf[128];
+} web3_sha512_ctx_t;
+
+void web3_sha256_init(web3_sha256_ctx_t* ctx);
+void web3_sha256_update(web3_sha256_ctx_t* ctx, const void* data, size_t len);
+void web3_sha256_final(web3_sha256_ctx_t* ctx, uint8_t out[WEB3_SHA256_LEN]);
+
+void web3_sha512_256_init(web3_sha512_ctx_t* ctx);
+void web3_sha512_256_update(web3_sha512_ctx_t* ctx, const void* data, size_t len);
+void web3_sha512_256_final(web3_sha512_ctx_t* ctx, uint8_t out[WEB3_SHA512_256_LEN]);
+
+// Name of the SHA-256 block kernel in use ("shani" or "generic")
+const char* web3_sha256_impl(void);
+
+#endif
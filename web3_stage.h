@@ -0,0 +1,34 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Stages of an authentication check
+ *
+ * Tracing and profiling name the same stages, so both use this list.
+ */
+
+#ifndef _WEB3_STAGE_H_
+#define _WEB3_STAGE_H_
+
+typedef enum web3_stage {
+    WEB3_STAGE_AUTH = 0,        // the whole check
+    WEB3_STAGE_QUEUE,           // request received until the check started
+    WEB3_STAGE_EXTRACT,         // finding and parsing the credentials
+    WEB3_STAGE_VALIDATE,        // checking them before any contract call
+    WEB3_STAGE_CACHE,           // HA1 cache lookup
+    WEB3_STAGE_ENCODE,          // JSON-RPC payload and ABI encoding
+    WEB3_STAGE_RPC,             // eth_call, split into the phases below
+    WEB3_STAGE_RPC_DNS,
+    WEB3_STAGE_RPC_CONNECT,
+    WEB3_STAGE_RPC_TLS,
+    WEB3_STAGE_RPC_SERVER,
+    WEB3_STAGE_RPC_TRANSFER,
+    WEB3_STAGE_PARSE,           // JSON-RPC response handling
+    WEB3_STAGE_DIGEST,          // local response computation from HA1
+    WEB3_STAGE_COUNT
+} web3_stage_t;
+
+static const char* const web3_stage_names[WEB3_STAGE_COUNT] = {
+    "web3_auth", "queue", "extract", "validate", "cache", "encode", "eth_call",
+    "dns", "connect", "tls", "server", "transfer", "parse", "digest"
+};
+
+#endif
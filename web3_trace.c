@@ -0,0 +1,390 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Sampled tracing of authentication checks
+ *
+ * Each ring has a single producer, the worker owning it, and a single
+ * consumer, the exporter. The producer publishes a span by advancing
+ * 'head' with release order after writing it; the exporter frees slots by
+ * advancing 'tail' after copying them out. Neither side ever waits: a
+ * full ring drops the span.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <curl/curl.h>
+
+#include "../../core/dprint.h"
+#include "../../core/pt.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "web3_hex.h"
+#include "web3_trace.h"
+
+#define TRACE_RING_SIZE 1024        // spans per process, a power of two
+#define TRACE_BATCH 256             // spans per OTLP request
+#define TRACE_SPAN_JSON 448         // per span, without the endpoint
+#define TRACE_POST_TIMEOUT 2000     // ms
+
+#define SPAN_KIND_INTERNAL 1
+#define SPAN_KIND_CLIENT 3
+#define STATUS_CODE_ERROR 2
+
+typedef struct trace_span {
+    uint8_t trace_id[WEB3_TRACE_ID_SIZE];
+    uint8_t span_id[WEB3_SPAN_ID_SIZE];
+    uint8_t parent_id[WEB3_SPAN_ID_SIZE];  // all zero for the root span
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int32_t code;
+    uint8_t stage;
+    uint8_t error;
+} trace_span_t;
+
+// Producer and consumer indexes on separate cache lines
+typedef struct trace_ring {
+    uint32_t head;
+    uint32_t dropped;
+    char pad1[56];
+    uint32_t tail;
+    char pad2[60];
+    trace_span_t spans[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t* trace_rings = NULL;
+static int trace_nprocs = 0;
+static uint64_t trace_threshold = 0;    // sampled if a random value is below
+static int trace_all = 0;
+
+// Per process: random state and the open trace
+static uint64_t trace_rng = 0;
+static int trace_open = 0;
+static uint8_t trace_id[WEB3_TRACE_ID_SIZE];
+static uint8_t root_id[WEB3_SPAN_ID_SIZE];
+static uint64_t root_start = 0;
+
+// Per exporter: batch, JSON buffer and the collector connection
+static trace_span_t* batch = NULL;
+static char* json = NULL;
+static int json_size = 0;
+static CURL* collector = NULL;
+static struct curl_slist* collector_headers = NULL;
+static int collector_failing = 0;
+static int exporter_failed = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*; never returns 0, so ids are valid W3C ids
+static uint64_t trace_random(void) {
+    if (trace_rng == 0) {
+        trace_rng = (now_ns() ^ ((uint64_t)getpid() << 32)) | 1;
+    }
+    trace_rng ^= trace_rng >> 12;
+    trace_rng ^= trace_rng << 25;
+    trace_rng ^= trace_rng >> 27;
+    return trace_rng * 0x2545F4914F6CDD1DULL;
+}
+
+int web3_trace_init(int nprocs, double ratio) {
+    size_t size = (size_t)nprocs * sizeof(trace_ring_t);
+
+    if (nprocs <= 0) return -1;
+
+    trace_rings = shm_malloc(size);
+    if (!trace_rings) {
+        SHM_MEM_ERROR;
+        return -1;
+    }
+    memset(trace_rings, 0, size);
+    trace_nprocs = nprocs;
+
+    trace_all = ratio >= 1.0;
+    trace_threshold = trace_all ? 0 : (uint64_t)(ratio * 18446744073709551616.0);
+    return 0;
+}
+
+void web3_trace_destroy(void) {
+    if (collector) {
+        curl_easy_cleanup(collector);
+        collector = NULL;
+    }
+    if (collector_headers) {
+        curl_slist_free_all(collector_headers);
+        collector_headers = NULL;
+    }
+    if (trace_rings) {
+        shm_free(trace_rings);
+        trace_rings = NULL;
+    }
+}
+
+int web3_trace_begin(uint64_t start_ns) {
+    uint64_t r;
+
+    trace_open = 0;
+    if (!trace_rings) return 0;
+
+    r = trace_random();
+    if (!trace_all && r >= trace_threshold) return 0;
+
+    r = trace_random();
+    memcpy(trace_id, &r, 8);
+    r = trace_random();
+    memcpy(trace_id + 8, &r, 8);
+    web3_trace_new_id(root_id);
+    root_start = start_ns;
+    trace_open = 1;
+    return 1;
+}
+
+uint64_t web3_trace_clock(void) {
+    return trace_open ? now_ns() : 0;
+}
+
+void web3_trace_new_id(uint8_t id[WEB3_SPAN_ID_SIZE]) {
+    uint64_t r = trace_random();
+    memcpy(id, &r, WEB3_SPAN_ID_SIZE);
+}
+
+static void trace_push(const trace_span_t* span) {
+    trace_ring_t* ring;
+    uint32_t head, tail;
+
+    if (process_no < 0 || process_no >= trace_nprocs) return;
+    ring = &trace_rings[process_no];
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= TRACE_RING_SIZE) {
+        ring->dropped++;
+        return;
+    }
+    ring->spans[head & (TRACE_RING_SIZE - 1)] = *span;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void web3_trace_span(web3_stage_t stage, const uint8_t* id, const uint8_t* parent,
+        uint64_t start_ns, uint64_t end_ns, int code, int error) {
+    trace_span_t span;
+
+    if (!trace_open || start_ns == 0) return;
+
+    memcpy(span.trace_id, trace_id, WEB3_TRACE_ID_SIZE);
+    if (id) {
+        memcpy(span.span_id, id, WEB3_SPAN_ID_SIZE);
+    } else {
+        web3_trace_new_id(span.span_id);
+    }
+    memcpy(span.parent_id, parent ? parent : root_id, WEB3_SPAN_ID_SIZE);
+    span.start_ns = start_ns;
+    span.end_ns = end_ns;
+    span.code = code;
+    span.stage = (uint8_t)stage;
+    span.error = error ? 1 : 0;
+    trace_push(&span);
+}
+
+void web3_trace_stage(web3_stage_t stage, uint64_t start_ns, int code, int error) {
+    if (!trace_open || start_ns == 0) return;
+    web3_trace_span(stage, NULL, NULL, start_ns, now_ns(), code, error);
+}
+
+void web3_trace_end(int code, int error) {
+    trace_span_t span;
+
+    if (!trace_open) return;
+
+    memcpy(span.trace_id, trace_id, WEB3_TRACE_ID_SIZE);
+    memcpy(span.span_id, root_id, WEB3_SPAN_ID_SIZE);
+    memset(span.parent_id, 0, WEB3_SPAN_ID_SIZE);
+    span.start_ns = root_start;
+    span.end_ns = now_ns();
+    span.code = code;
+    span.stage = WEB3_STAGE_AUTH;
+    span.error = error ? 1 : 0;
+    trace_push(&span);
+    trace_open = 0;
+}
+
+void web3_trace_traceparent(const uint8_t id[WEB3_SPAN_ID_SIZE],
+        char buf[WEB3_TRACEPARENT_SIZE]) {
+    char trace_hex[2 * WEB3_TRACE_ID_SIZE];
+    char span_hex[2 * WEB3_SPAN_ID_SIZE];
+
+    web3_hex_encode(trace_id, WEB3_TRACE_ID_SIZE, trace_hex);
+    web3_hex_encode(id, WEB3_SPAN_ID_SIZE, span_hex);
+    snprintf(buf, WEB3_TRACEPARENT_SIZE, "traceparent: 00-%.32s-%.16s-01", trace_hex, span_hex);
+}
+
+unsigned long web3_trace_dropped(void) {
+    unsigned long n = 0;
+
+    for (int p = 0; p < trace_nprocs; p++) {
+        n += trace_rings[p].dropped;
+    }
+    return n;
+}
+
+static size_t discard_cb(void* data, size_t size, size_t nmemb, void* userp) {
+    return size * nmemb;
+}
+
+// Append 'src' as a JSON string body, escaping quotes and control chars
+static int json_escape(char* out, int size, const char* src) {
+    int len = 0;
+
+    for (; *src && len < size - 6; src++) {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\') {
+            out[len++] = '\\';
+            out[len++] = c;
+        } else if (c < 0x20) {
+            len += snprintf(out + len, size - len, "\\u%04x", c);
+        } else {
+            out[len++] = c;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// Encode one batch as an OTLP ExportTraceServiceRequest (JSON mapping);
+// json_size is chosen so that a full batch always fits
+static int trace_encode(int n, const char* service, const char* endpoint) {
+    char trace_hex[2 * WEB3_TRACE_ID_SIZE + 1] = {0};
+    char span_hex[2 * WEB3_SPAN_ID_SIZE + 1] = {0};
+    char parent_hex[2 * WEB3_SPAN_ID_SIZE + 1] = {0};
+    static const uint8_t no_parent[WEB3_SPAN_ID_SIZE] = {0};
+    int len;
+
+    len = snprintf(json, json_size, "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+            "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"");
+    len += json_escape(json + len, json_size - len, service);
+    len += snprintf(json + len, json_size - len, "\"}}]},\"scopeSpans\":[{"
+            "\"scope\":{\"name\":\"web3_auth\"},\"spans\":[");
+
+    for (int i = 0; i < n; i++) {
+        const trace_span_t* s = &batch[i];
+        int rpc = s->stage == WEB3_STAGE_RPC;
+
+        web3_hex_encode(s->trace_id, WEB3_TRACE_ID_SIZE, trace_hex);
+        web3_hex_encode(s->span_id, WEB3_SPAN_ID_SIZE, span_hex);
+        len += snprintf(json + len, json_size - len,
+                "%s{\"traceId\":\"%s\",\"spanId\":\"%s\",", i ? "," : "", trace_hex, span_hex);
+        if (memcmp(s->parent_id, no_parent, WEB3_SPAN_ID_SIZE) != 0) {
+            web3_hex_encode(s->parent_id, WEB3_SPAN_ID_SIZE, parent_hex);
+            len += snprintf(json + len, json_size - len, "\"parentSpanId\":\"%s\",", parent_hex);
+        }
+        len += snprintf(json + len, json_size - len,
+                "\"name\":\"%s\",\"kind\":%d,\"startTimeUnixNano\":\"%llu\","
+                "\"endTimeUnixNano\":\"%llu\",\"attributes\":[{\"key\":\"web3_auth.code\","
+                "\"value\":{\"intValue\":\"%d\"}}",
+                s->stage < WEB3_STAGE_COUNT ? web3_stage_names[s->stage] : "unknown",
+                rpc ? SPAN_KIND_CLIENT : SPAN_KIND_INTERNAL,
+                (unsigned long long)s->start_ns, (unsigned long long)s->end_ns, s->code);
+        if (rpc) {
+            len += snprintf(json + len, json_size - len,
+                    ",{\"key\":\"url.full\",\"value\":{\"stringValue\":\"");
+            len += json_escape(json + len, json_size - len, endpoint);
+            len += snprintf(json + len, json_size - len, "\"}}");
+        }
+        if (s->error) {
+            len += snprintf(json + len, json_size - len, "],\"status\":{\"code\":%d}}",
+                    STATUS_CODE_ERROR);
+        } else {
+            len += snprintf(json + len, json_size - len, "]}");
+        }
+        if (len >= json_size) return -1;
+    }
+
+    len += snprintf(json + len, json_size - len, "]}]}]}");
+    return len < json_size ? len : -1;
+}
+
+static void trace_post(int n, const char* url, const char* service, const char* endpoint) {
+    CURLcode res;
+    long status = 0;
+    int len;
+
+    len = trace_encode(n, service, endpoint);
+    if (len < 0) {
+        LM_ERR("OTLP batch of %d spans does not fit in %d bytes\n", n, json_size);
+        return;
+    }
+
+    curl_easy_setopt(collector, CURLOPT_POSTFIELDS, json);
+    curl_easy_setopt(collector, CURLOPT_POSTFIELDSIZE, (long)len);
+    res = curl_easy_perform(collector);
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(collector, CURLINFO_RESPONSE_CODE, &status);
+    }
+
+    // Log state changes only, the exporter runs several times a second
+    if (res != CURLE_OK || status < 200 || status >= 300) {
+        if (!collector_failing) {
+            LM_WARN("Cannot export spans to %s: %s (HTTP %ld), dropping them\n", url,
+                    res != CURLE_OK ? curl_easy_strerror(res) : "rejected", status);
+        }
+        collector_failing = 1;
+    } else if (collector_failing) {
+        LM_INFO("Exporting spans to %s again\n", url);
+        collector_failing = 0;
+    }
+}
+
+static int trace_exporter_init(const char* url, const char* service, const char* endpoint) {
+    batch = pkg_malloc(TRACE_BATCH * sizeof(trace_span_t));
+    json_size = 256 + 6 * strlen(service) + TRACE_BATCH * (TRACE_SPAN_JSON + 6 * strlen(endpoint));
+    json = pkg_malloc(json_size);
+    if (!batch || !json) {
+        PKG_MEM_ERROR;
+        return -1;
+    }
+
+    collector = curl_easy_init();
+    if (!collector) {
+        LM_ERR("Failed to initialize curl for the OTLP exporter\n");
+        return -1;
+    }
+    collector_headers = curl_slist_append(NULL, "Content-Type: application/json");
+    curl_easy_setopt(collector, CURLOPT_URL, url);
+    curl_easy_setopt(collector, CURLOPT_HTTPHEADER, collector_headers);
+    curl_easy_setopt(collector, CURLOPT_WRITEFUNCTION, discard_cb);
+    curl_easy_setopt(collector, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(collector, CURLOPT_TIMEOUT_MS, (long)TRACE_POST_TIMEOUT);
+    return 0;
+}
+
+void web3_trace_export(const char* url, const char* service, const char* endpoint) {
+    int n = 0;
+
+    if (!trace_rings || exporter_failed) return;
+    if (!collector && trace_exporter_init(url, service, endpoint) < 0) {
+        exporter_failed = 1;
+        return;
+    }
+
+    for (int p = 0; p < trace_nprocs; p++) {
+        trace_ring_t* ring = &trace_rings[p];
+        uint32_t tail = ring->tail;
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            batch[n++] = ring->spans[tail & (TRACE_RING_SIZE - 1)];
+            tail++;
+            if (n == TRACE_BATCH) {
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+                trace_post(n, url, service, endpoint);
+                n = 0;
+            }
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (n > 0) trace_post(n, url, service, endpoint);
+}
@@ -0,0 +1,63 @@
+/*
+ * Web3 Authentication Module for Kamailio
+ * Sampled tracing of authentication checks
+ *
+ * A sampled check becomes one trace: a root span for the check and child
+ * spans for its stages. Workers append finished spans to a ring of their
+ * own in shared memory; one exporter process drains all rings and posts
+ * them as OTLP/HTTP JSON to a collector. An unsampled check costs one
+ * random number.
+ */
+
+#ifndef _WEB3_TRACE_H_
+#define _WEB3_TRACE_H_
+
+#include <stdint.h>
+
+#include "web3_stage.h"
+
+#define WEB3_TRACE_ID_SIZE 16
+#define WEB3_SPAN_ID_SIZE 8
+
+// "traceparent: 00-<trace id>-<span id>-01" plus NUL
+#define WEB3_TRACEPARENT_SIZE (13 + 3 + 32 + 1 + 16 + 3 + 1)
+
+// Allocate the rings of 'nprocs' processes; 'ratio' (0..1) of the checks
+// are sampled. Must run before forking.
+int web3_trace_init(int nprocs, double ratio);
+void web3_trace_destroy(void);
+
+// Start a trace for a check starting at 'start_ns', if it is sampled;
+// returns 1 if it is
+int web3_trace_begin(uint64_t start_ns);
+
+// Close the root span of the current trace with the check's result
+void web3_trace_end(int code, int error);
+
+// Current time in ns since the epoch while a trace is open, else 0
+uint64_t web3_trace_clock(void);
+
+// New random span id
+void web3_trace_new_id(uint8_t id[WEB3_SPAN_ID_SIZE]);
+
+// Record a finished span of the current trace. 'id' NULL gets a fresh id,
+// 'parent' NULL makes it a child of the root span. Spans that do not fit
+// in the ring are dropped and counted.
+void web3_trace_span(web3_stage_t stage, const uint8_t* id, const uint8_t* parent,
+        uint64_t start_ns, uint64_t end_ns, int code, int error);
+
+// Shorthand for a child of the root span ending now
+void web3_trace_stage(web3_stage_t stage, uint64_t start_ns, int code, int error);
+
+// Format the W3C traceparent header naming span 'id' as the parent
+void web3_trace_traceparent(const uint8_t id[WEB3_SPAN_ID_SIZE],
+        char buf[WEB3_TRACEPARENT_SIZE]);
+
+// Spans dropped on full rings, all processes
+unsigned long web3_trace_dropped(void);
+
+// Exporter: post everything queued to 'url', run from a timer process.
+// 'service' and 'endpoint' are reported as resource and RPC attributes.
+void web3_trace_export(const char* url, const char* service, const char* endpoint);
+
+#endif